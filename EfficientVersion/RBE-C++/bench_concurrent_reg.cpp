@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "ConcurrentRegistrar.h"
+#include "InMemoryStorage.h"
+#include "RBE_Common.h"
+#include "SQLiteStorage.h"
+#include "ShardedStorage.h"
+#include "algos.h"
+
+// 并发注册的扩展性：同一批注册请求，用 1, 2, 4, ... 个线程经
+// ConcurrentRegistrar 注册，比较吞吐量 (每秒注册数)
+//   memory  InMemoryStorage，支持按块并发
+//   sharded ShardedStorage (8 个分片)，每个分片一把锁
+//   sqlite  单个 SQLiteStorage，不支持并发，整体串行 (对照组)
+//
+// 用法: bench_concurrent_reg [N] [max_threads]
+//       (默认 N=1024，即 n=32、32 个块，全部注册满；max_threads 默认为 CPU 数)
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string kDbDir = "EfficientVersion/sqlite3_db/";
+
+static void remove_db(const std::string& path) {
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+}
+
+// 在新建的存储上注册全部请求，返回每秒注册数
+static double run(const CRS& crs, const std::vector<RegRequest>& requests,
+                  Storage* storage, int threads) {
+    ConcurrentRegistrar registrar(crs, storage);
+    auto t0 = Clock::now();
+    registrar.reg_parallel(requests, threads);
+    auto t1 = Clock::now();
+    double seconds = std::chrono::duration<double>(t1 - t0).count();
+    return requests.size() / seconds;
+}
+
+static double bench_memory(const CRS& crs,
+                           const std::vector<RegRequest>& requests,
+                           int threads) {
+    InMemoryStorage store(crs);
+    return run(crs, requests, &store, threads);
+}
+
+static double bench_sharded(const CRS& crs,
+                            const std::vector<RegRequest>& requests,
+                            int threads) {
+    const int shards = 8;
+    const std::string prefix = kDbDir + "bench_concurrent_shard";
+    for (int i = 0; i < shards; ++i) {
+        remove_db(prefix + "_" + std::to_string(i) + ".db");
+    }
+    double rate;
+    {
+        ShardedStorage store(prefix, shards, crs.n);
+        rate = run(crs, requests, &store, threads);
+    }
+    for (int i = 0; i < shards; ++i) {
+        remove_db(prefix + "_" + std::to_string(i) + ".db");
+    }
+    return rate;
+}
+
+static double bench_sqlite(const CRS& crs,
+                           const std::vector<RegRequest>& requests,
+                           int threads) {
+    const std::string path = kDbDir + "bench_concurrent.db";
+    remove_db(path);
+    double rate;
+    {
+        SQLiteStorage store(path);
+        rate = run(crs, requests, &store, threads);
+    }
+    remove_db(path);
+    return rate;
+}
+
+int main(int argc, char** argv) {
+    init_rbe_library();
+    rbe_verbose = false;
+
+    int N = argc > 1 ? std::atoi(argv[1]) : 1024;
+    int max_threads = argc > 2 ? std::atoi(argv[2])
+                               : (int)std::thread::hardware_concurrency();
+    if (max_threads < 1) max_threads = 1;
+    CRS crs = setup(N);
+
+    std::vector<RegRequest> requests(N);
+    for (int id = 0; id < N; ++id) {
+        UserKeys keys = gen(crs, id);
+        requests[id] = {id, keys.pk, keys.xi};
+    }
+
+    std::cout << "=== Concurrent reg, N=" << N << ", " << (N + crs.n - 1) / crs.n
+              << " blocks (registrations / s) ===" << std::endl;
+    std::cout << "| threads | memory     | sharded    | sqlite     |"
+              << std::endl;
+    for (int threads = 1;; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        std::cout << "| " << std::setw(7) << threads << " | " << std::setw(10)
+                  << std::fixed << std::setprecision(1)
+                  << bench_memory(crs, requests, threads) << " | "
+                  << std::setw(10) << bench_sharded(crs, requests, threads)
+                  << " | " << std::setw(10)
+                  << bench_sqlite(crs, requests, threads) << " |"
+                  << std::endl;
+        if (threads == max_threads) break;
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FixedBase.h"
+#include "InMemoryStorage.h"
+#include "PairingTables.h"
+#include "RBE_Common.h"
+#include "algos.h"
+
+// 加密延迟：
+// 1. 单个密文分量 (ct1, ct2, ct3) 的代价，逐步叠加各项优化：
+//      baseline  e(com, h)^r (GT 上求幂)，g2^r 与 e_zn1^r 照常计算
+//      g1-exp    e(r * com, h)，指数放到 G1 一侧
+//      +lines    再加 h_g2 / g2 的 Miller loop 系数表 (PairingTables)
+//      +fixed    再加 g2 / e_zn1 的固定底数表 (FixedBase)，即现在的 enc
+// 2. 端到端的 enc() 延迟 (InMemoryStorage，第 0 块注册满 n - 1 个用户，
+//    各层都有 commitment)，CRS 不带表 / 带全部表。
+// 3. 给 M 个接收者加密的吞吐量：逐个 enc 与 enc_batch (1 个线程 /
+//    全部核)，CRS 带全部表 (表在开头建好一次，不计入时间)。
+//
+// 用法: bench_enc [N] [iters] [M]
+//       默认 N=4096，即 n=64；iters=200；M=1000
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_us(Clock::time_point t0, Clock::time_point t1) {
+    return std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+// 已排序的样本的百分位数
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static void print_row(const std::string& name, std::vector<double>& us) {
+    std::sort(us.begin(), us.end());
+    double sum = 0;
+    for (double v : us) sum += v;
+    std::cout << "| " << std::setw(9) << name << " | " << std::setw(8)
+              << sum / us.size() << " | " << std::setw(8)
+              << percentile(us, 0.50) << " | " << std::setw(8)
+              << percentile(us, 0.99) << " |" << std::endl;
+}
+
+// 一个密文分量；variant 见文件开头的说明 (0 = baseline)
+static void component(const CRS& crs, int variant, const G1& com,
+                      int64_t h_idx, const GT& message,
+                      CiphertextComponent& comp) {
+    Fr r;
+    r.setRand();
+    comp.ct0 = com;
+    if (variant == 0) {
+        GT pair_val;
+        pairing(pair_val, com, crs.h_g2[h_idx]);
+        GT::pow(comp.ct1, pair_val, r);
+        G2::mul(comp.ct2, crs.g2, r);
+        GT e_val_r;
+        GT::pow(e_val_r, crs.e_zn1, r);
+        GT::mul(comp.ct3, e_val_r, message);
+        return;
+    }
+    G1 com_r;
+    G1::mul(com_r, com, r);
+    crs_miller_loop_h(crs, comp.ct1, com_r, h_idx);
+    finalExp(comp.ct1, comp.ct1);
+    crs_mul_g2(crs, comp.ct2, r);
+    GT e_val_r;
+    crs_pow_e_zn1(crs, e_val_r, r);
+    GT::mul(comp.ct3, e_val_r, message);
+}
+
+int main(int argc, char** argv) {
+    init_rbe_library();
+    rbe_verbose = false;
+
+    int64_t N = argc > 1 ? std::atoll(argv[1]) : 4096;
+    int iters = argc > 2 ? std::atoi(argv[2]) : 200;
+    int M = argc > 3 ? std::atoi(argv[3]) : 1000;
+    CRS crs = setup(N);
+    const int64_t n = crs.n;
+
+    // 第 0 块注册 n - 1 个用户 (id 1 .. n-1)，第 0 层一定有 commitment
+    InMemoryStorage storage(crs);
+    for (int64_t id = 1; id < n; ++id) {
+        UserKeys keys = gen(crs, id);
+        reg(crs, &storage, id, keys.pk, keys.xi);
+    }
+    const int64_t target = n / 2;
+    const int64_t h_idx = n - target;
+    G1 com = storage.getPPCommitment(0, 0);
+    GT message;
+    pairing(message, crs.g1, crs.g2);
+
+    CRS plain = crs;
+    CRS lines = crs;
+    crs_enable_precompute(lines, 64 << 20, true);
+    CRS full = lines;
+    crs_enable_fixed_base(full);
+
+    const CRS* variants[] = {&plain, &plain, &lines, &full};
+    const char* names[] = {"baseline", "g1-exp", "+lines", "+fixed"};
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "=== one ciphertext component, N=" << N << " (n=" << n
+              << "), " << iters << " iters (us) ===" << std::endl;
+    std::cout << "| variant   | mean     | p50      | p99      |" << std::endl;
+    for (int v = 0; v < 4; ++v) {
+        std::vector<double> us;
+        CiphertextComponent comp;
+        for (int i = 0; i < iters; ++i) {
+            auto t0 = Clock::now();
+            component(*variants[v], v, com, h_idx, message, comp);
+            us.push_back(elapsed_us(t0, Clock::now()));
+        }
+        print_row(names[v], us);
+    }
+
+    size_t components = enc(crs, &storage, target, message).components.size();
+    std::cout << std::endl
+              << "=== enc(), " << components << " components (us) ==="
+              << std::endl;
+    std::cout << "| CRS       | mean     | p50      | p99      |" << std::endl;
+    const CRS* crs_variants[] = {&plain, &full};
+    const char* crs_names[] = {"no tables", "tables"};
+    for (int v = 0; v < 2; ++v) {
+        std::vector<double> us;
+        for (int i = 0; i < iters; ++i) {
+            auto t0 = Clock::now();
+            enc(*crs_variants[v], &storage, target, message);
+            us.push_back(elapsed_us(t0, Clock::now()));
+        }
+        print_row(crs_names[v], us);
+    }
+
+    // 接收者轮流取第 0 块里的各个位置
+    std::vector<EncRequest> requests(M);
+    for (int i = 0; i < M; ++i) requests[i] = {i % n, message};
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << std::endl
+              << "=== " << M << " recipients, tables in CRS ===" << std::endl;
+    std::cout << "| method          | enc / s    |" << std::endl;
+    auto report = [&](const std::string& name, double us) {
+        std::cout << "| " << std::setw(15) << name << " | " << std::setw(10)
+                  << M / (us / 1e6) << " |" << std::endl;
+    };
+    auto t0 = Clock::now();
+    for (const EncRequest& req : requests) {
+        enc(full, &storage, req.id, req.message);
+    }
+    report("enc loop", elapsed_us(t0, Clock::now()));
+    t0 = Clock::now();
+    enc_batch(full, &storage, requests, 1);
+    report("enc_batch x1", elapsed_us(t0, Clock::now()));
+    if (cores > 1) {
+        t0 = Clock::now();
+        enc_batch(full, &storage, requests, cores);
+        report("enc_batch x" + std::to_string(cores),
+               elapsed_us(t0, Clock::now()));
+    }
+    return 0;
+}
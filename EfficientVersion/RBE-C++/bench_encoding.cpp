@@ -0,0 +1,178 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "RBE_Common.h"
+#include "SQLiteStorage.h"
+#include "algos.h"
+
+// 对比两种存储点编码：压缩 (IoSerialize) 与未压缩仿射 (IoEcAffineSerialize)
+// 1. 单点编解码的 CPU 开销与字节数，以及整向量批量归一化序列化的收益
+// 2. 用 SQLiteStorage 跑 reg / enc / upd 的平均耗时与数据库大小
+//
+// 用法: bench_encoding [N]   (默认 N=4096，即 n=64；注册满第 0 块)
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_us(Clock::time_point t0, Clock::time_point t1) {
+    return std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+static long file_size(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return 0;
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    std::fclose(f);
+    return size;
+}
+
+static const char* mode_name(int mode) {
+    return (mode & mcl::IoEcAffineSerialize) ? "affine" : "compressed";
+}
+
+// --- 1. 单点编解码 ---
+static void bench_point_codec(int mode) {
+    const int iters = 2000;
+    G1 p;
+    hashAndMapToG1(p, "bench_encoding", 14);
+    std::string bin = g1_to_bin(p, mode);
+
+    auto t0 = Clock::now();
+    for (int i = 0; i < iters; ++i) {
+        bin = g1_to_bin(p, mode);
+    }
+    auto t1 = Clock::now();
+    G1 q;
+    for (int i = 0; i < iters; ++i) {
+        q = stored_bin_to_g1(bin.data(), bin.size(), mode);
+    }
+    auto t2 = Clock::now();
+
+    if (q != p) {
+        std::cout << "[FAIL] Round trip mismatch for " << mode_name(mode)
+                  << std::endl;
+    }
+    std::cout << "| " << std::setw(10) << mode_name(mode) << " | "
+              << std::setw(5) << bin.size() << " | " << std::setw(10)
+              << std::fixed << std::setprecision(2)
+              << elapsed_us(t0, t1) / iters << " | " << std::setw(10)
+              << elapsed_us(t1, t2) / iters << " |" << std::endl;
+}
+
+// --- 1b. 整向量序列化：逐点 g1_to_bin vs 批量归一化的 g1vec_to_bin ---
+static void bench_vector_codec(int mode) {
+    const int n = 256, iters = 20;
+    // 构造 n 个 Jacobian 坐标 (z != 1) 的点，模拟合并后刚相加出来的 Aux
+    std::vector<G1> vec(n);
+    G1 base;
+    hashAndMapToG1(base, "bench_vector", 12);
+    vec[0] = base;
+    for (int i = 1; i < n; ++i) G1::add(vec[i], vec[i - 1], base);
+
+    std::string per_point, batched;
+    auto t0 = Clock::now();
+    for (int it = 0; it < iters; ++it) {
+        per_point.clear();
+        for (const G1& p : vec) per_point += g1_to_bin(p, mode);
+    }
+    auto t1 = Clock::now();
+    for (int it = 0; it < iters; ++it) {
+        batched = g1vec_to_bin(vec, mode);
+    }
+    auto t2 = Clock::now();
+
+    if (per_point != batched) {
+        std::cout << "[FAIL] Vector encoding mismatch for " << mode_name(mode)
+                  << std::endl;
+    }
+    std::cout << "| " << std::setw(10) << mode_name(mode) << " | "
+              << std::setw(14) << std::fixed << std::setprecision(2)
+              << elapsed_us(t0, t1) / (iters * n) << " | " << std::setw(14)
+              << elapsed_us(t1, t2) / (iters * n) << " |" << std::endl;
+}
+
+// --- 2. reg / enc / upd ---
+static void bench_storage(const CRS& crs, int mode) {
+    std::string db_file = std::string("EfficientVersion/sqlite3_db/"
+                                      "bench_encoding_") +
+                          mode_name(mode) + ".db";
+    std::remove(db_file.c_str());
+    std::remove((db_file + "-wal").c_str());
+    std::remove((db_file + "-shm").c_str());
+
+    double reg_us = 0, enc_us = 0, upd_us = 0;
+    int users = crs.n;
+    {
+        SQLiteStorage store(db_file, mode);
+        Storage* storage = &store;
+
+        std::vector<UserKeys> keys(users);
+        for (int id = 0; id < users; ++id) keys[id] = gen(crs, id);
+
+        auto t0 = Clock::now();
+        for (int id = 0; id < users; ++id) {
+            reg(crs, storage, id, keys[id].pk, keys[id].xi);
+        }
+        auto t1 = Clock::now();
+        reg_us = elapsed_us(t0, t1) / users;
+
+        GT msg;
+        mcl::bn::pairing(msg, crs.g1, crs.g2);
+        t0 = Clock::now();
+        for (int id = 0; id < users; ++id) {
+            Ciphertext ct = enc(crs, storage, id, msg);
+        }
+        t1 = Clock::now();
+        enc_us = elapsed_us(t0, t1) / users;
+
+        t0 = Clock::now();
+        for (int id = 0; id < users; ++id) {
+            upd(crs, storage, id);
+        }
+        t1 = Clock::now();
+        upd_us = elapsed_us(t0, t1) / users;
+    }
+    long db_bytes = file_size(db_file) + file_size(db_file + "-wal");
+
+    std::cout << "| " << std::setw(10) << mode_name(mode) << " | "
+              << std::setw(10) << std::fixed << std::setprecision(1)
+              << reg_us / 1000 << " | " << std::setw(10) << enc_us / 1000
+              << " | " << std::setw(10) << upd_us / 1000 << " | "
+              << std::setw(10) << db_bytes / 1024 << " |" << std::endl;
+
+    std::remove(db_file.c_str());
+    std::remove((db_file + "-wal").c_str());
+    std::remove((db_file + "-shm").c_str());
+}
+
+int main(int argc, char** argv) {
+    init_rbe_library();
+    rbe_verbose = false;
+
+    int N = argc > 1 ? std::atoi(argv[1]) : 4096;
+    CRS crs = setup(N);
+    const int modes[] = {mcl::IoSerialize, mcl::IoEcAffineSerialize};
+
+    std::cout << "=== Point codec (per point) ===" << std::endl;
+    std::cout << "| encoding   | bytes | encode us  | decode us  |"
+              << std::endl;
+    for (int mode : modes) bench_point_codec(mode);
+
+    std::cout << "\n=== Vector encode of Jacobian points (per point) ==="
+              << std::endl;
+    std::cout << "| encoding   | per-point us   | batched us     |"
+              << std::endl;
+    for (int mode : modes) bench_vector_codec(mode);
+
+    std::cout << "\n=== SQLiteStorage, N=" << N << ", " << crs.n
+              << " users in block 0 ===" << std::endl;
+    std::cout << "| encoding   | reg ms     | enc ms     | upd ms     | db KiB  "
+                 "   |"
+              << std::endl;
+    for (int mode : modes) bench_storage(crs, mode);
+    return 0;
+}
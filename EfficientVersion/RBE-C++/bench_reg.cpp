@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CachingStorage.h"
+#include "InMemoryStorage.h"
+#include "MmapStorage.h"
+#include "RBE_Common.h"
+#include "SQLiteStorage.h"
+#include "ShardedStorage.h"
+#include "algos.h"
+
+// 注册的吞吐量与延迟：在每种存储后端上从空库开始注册同样的 M 个用户，报告
+//   - 吞吐量 (每秒注册数) 与单次 reg 延迟的 p50 / p99 / max。吞吐量的
+//     时间包括最后关闭存储 (close ms 一栏)：缓存层在这时才把剩下的脏数据
+//     写回，不算进去的话它的写入量有了、耗时却没有；
+//   - 按落座层分组的延迟 (落到第 j 层要吸收 j 个旧层，代价随 j 增长)；
+//   - 写入的字节数：write() 系统调用写出的字节 (/proc/self/io 的 wchar)
+//     和结束时数据文件的大小。mmap 经页缓存写回，不走 write()。
+// 用户从 0 .. N-1 中随机抽取 (种子固定)，各后端的注册顺序相同。
+//
+// 用法: bench_reg [N] [M] [backends]
+//       默认 N=4096 (n=64)，M=1024；backends 是逗号分隔的列表，默认全部：
+//       memory,mmap,sqlite,caching,sharded
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string kDbDir = "EfficientVersion/sqlite3_db/";
+
+static long file_size(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return 0;
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    std::fclose(f);
+    return size;
+}
+
+static void remove_db(const std::string& path) {
+    std::remove(path.c_str());
+    std::remove((path + "-wal").c_str());
+    std::remove((path + "-shm").c_str());
+}
+
+// 本进程到目前为止经 write() 写出的字节数 (读不到时返回 0)
+static long long write_bytes() {
+    FILE* f = std::fopen("/proc/self/io", "r");
+    if (!f) return 0;
+    char line[128];
+    long long bytes = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, "wchar:", 6) == 0) {
+            bytes = std::atoll(line + 6);
+            break;
+        }
+    }
+    std::fclose(f);
+    return bytes;
+}
+
+// 一种后端：新建存储，以及它用到的数据文件 (用于统计大小与清理)
+struct Backend {
+    std::string name;
+    std::unique_ptr<Storage> storage;
+    std::unique_ptr<Storage> inner;  // caching 包装的 SQLite
+    std::vector<std::string> files;
+};
+
+static bool make_backend(const std::string& name, const CRS& crs,
+                         Backend& b) {
+    b.name = name;
+    if (name == "memory") {
+        b.storage.reset(new InMemoryStorage(crs));
+    } else if (name == "mmap") {
+        b.files = {kDbDir + "bench_reg.mmap"};
+        std::remove(b.files[0].c_str());
+        b.storage.reset(new MmapStorage(b.files[0], crs));
+    } else if (name == "sqlite") {
+        b.files = {kDbDir + "bench_reg.db"};
+        remove_db(b.files[0]);
+        b.storage.reset(new SQLiteStorage(b.files[0]));
+    } else if (name == "caching") {
+        b.files = {kDbDir + "bench_reg_cached.db"};
+        remove_db(b.files[0]);
+        b.inner.reset(new SQLiteStorage(b.files[0]));
+        b.storage.reset(new CachingStorage(b.inner.get(), crs.n));
+    } else if (name == "sharded") {
+        const int shards = 4;
+        for (int i = 0; i < shards; ++i) {
+            b.files.push_back(kDbDir + "bench_reg_shard_" +
+                              std::to_string(i) + ".db");
+            remove_db(b.files.back());
+        }
+        b.storage.reset(
+            new ShardedStorage(kDbDir + "bench_reg_shard", shards, crs.n));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static long files_size(const std::vector<std::string>& files) {
+    long total = 0;
+    for (const std::string& f : files) {
+        total += file_size(f) + file_size(f + "-wal");
+    }
+    return total;
+}
+
+// 已排序的样本的百分位数
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+struct Result {
+    double rate = 0;
+    std::vector<double> latency_us;                  // 已排序
+    std::map<int, std::vector<double>> by_level;     // 落座层 -> 延迟 (已排序)
+    long long written = 0;
+    long file_bytes = 0;
+    double close_us = 0;  // 关闭存储 (含缓存层写回) 的耗时
+};
+
+static Result run(const CRS& crs, const std::vector<RegRequest>& requests,
+                  Backend& b) {
+    Result res;
+    Storage* st = b.storage.get();
+    long long w0 = write_bytes();
+    double total_us = 0;
+    for (const RegRequest& r : requests) {
+        // 落座层 = 块内用户数最低的连续 1 的个数 (见 reg 的进位链)
+        int64_t c = st->getBlockUserCount(r.id / crs.n);
+        int level = 0;
+        while ((c >> level) & 1) level++;
+
+        auto t0 = Clock::now();
+        reg(crs, st, r.id, r.pk, r.xi);
+        auto t1 = Clock::now();
+
+        double us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+        total_us += us;
+        res.latency_us.push_back(us);
+        res.by_level[level].push_back(us);
+    }
+    // 缓存层把剩下的脏数据写回，算进写入量和吞吐量的时间
+    auto t0 = Clock::now();
+    b.storage.reset();
+    b.inner.reset();
+    auto t1 = Clock::now();
+    res.close_us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+    res.written = write_bytes() - w0;
+    res.file_bytes = files_size(b.files);
+
+    res.rate = requests.size() / ((total_us + res.close_us) / 1e6);
+    std::sort(res.latency_us.begin(), res.latency_us.end());
+    for (auto& entry : res.by_level) {
+        std::sort(entry.second.begin(), entry.second.end());
+    }
+    for (const std::string& f : b.files) remove_db(f);
+    return res;
+}
+
+int main(int argc, char** argv) {
+    init_rbe_library();
+    rbe_verbose = false;
+
+    int64_t N = argc > 1 ? std::atoll(argv[1]) : 4096;
+    int64_t M = argc > 2 ? std::atoll(argv[2]) : 1024;
+    std::string list =
+        argc > 3 ? argv[3] : "memory,mmap,sqlite,caching,sharded";
+    if (M > N) M = N;
+    if (M < 1) M = 1;
+    CRS crs = setup(N);
+
+    // 随机抽 M 个不同的 id，并预先生成密钥 (不计入注册时间)
+    std::vector<int64_t> ids(N);
+    for (int64_t i = 0; i < N; ++i) ids[i] = i;
+    std::mt19937_64 rng(20240601);
+    std::shuffle(ids.begin(), ids.end(), rng);
+    ids.resize(M);
+    std::vector<RegRequest> requests(M);
+    for (int64_t i = 0; i < M; ++i) {
+        UserKeys keys = gen(crs, ids[i]);
+        requests[i] = {ids[i], keys.pk, keys.xi};
+    }
+
+    std::vector<std::pair<std::string, Result>> results;
+    std::stringstream names(list);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        Backend b;
+        if (!make_backend(name, crs, b)) {
+            std::cerr << "Unknown backend: " << name << std::endl;
+            continue;
+        }
+        results.emplace_back(name, run(crs, requests, b));
+    }
+
+    std::cout << "=== reg, N=" << N << " (n=" << crs.n << "), M=" << M
+              << " users ===" << std::endl;
+    std::cout << "| backend | reg / s    | p50 us   | p99 us   | max us   "
+                 "| close ms | write() bytes | file bytes   |"
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (auto& entry : results) {
+        const Result& r = entry.second;
+        std::cout << "| " << std::setw(7) << entry.first << " | "
+                  << std::setw(10) << r.rate << " | " << std::setw(8)
+                  << percentile(r.latency_us, 0.50) << " | " << std::setw(8)
+                  << percentile(r.latency_us, 0.99) << " | " << std::setw(8)
+                  << r.latency_us.back() << " | " << std::setw(8)
+                  << r.close_us / 1000 << " | " << std::setw(13)
+                  << r.written << " | " << std::setw(12) << r.file_bytes
+                  << " |" << std::endl;
+    }
+
+    std::cout << std::endl << "=== latency by landing level (us) ===" << std::endl;
+    std::cout << "| backend | level | count  | mean     | p50      | p99      |"
+              << std::endl;
+    for (auto& entry : results) {
+        for (auto& lvl : entry.second.by_level) {
+            const std::vector<double>& v = lvl.second;
+            double sum = 0;
+            for (double us : v) sum += us;
+            std::cout << "| " << std::setw(7) << entry.first << " | "
+                      << std::setw(5) << lvl.first << " | " << std::setw(6)
+                      << v.size() << " | " << std::setw(8) << sum / v.size()
+                      << " | " << std::setw(8) << percentile(v, 0.50)
+                      << " | " << std::setw(8) << percentile(v, 0.99) << " |"
+                      << std::endl;
+        }
+    }
+    return 0;
+}
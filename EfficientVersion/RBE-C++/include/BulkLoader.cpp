@@ -0,0 +1,250 @@
+#include <BulkLoader.h>
+#include <ConcurrentRegistrar.h>
+#include <RegJournal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// 读线程 -> 工作线程的有界队列，存未解码的 payload
+class PayloadQueue {
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+    std::deque<std::string> items;
+    size_t capacity;
+    bool closed = false;
+
+   public:
+    explicit PayloadQueue(size_t cap) : capacity(cap) {}
+
+    void push(std::string&& payload) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(payload));
+        not_empty.notify_one();
+    }
+    // 队列关闭且取空后返回 false
+    bool pop(std::string& payload) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        payload = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+    }
+};
+
+// 一个正在装填的块：当前未满的层 level，以及还没写下去的本层数据
+struct OpenBlock {
+    int64_t total = 0;   // 块的最终用户数
+    int64_t placed = 0;  // 已经收到的用户数
+    int level = -1;
+    int64_t filled = 0;  // 本层已装入的人数
+    G1 com;
+    std::vector<G1> aux;
+    std::vector<std::pair<int64_t, G1>> pks;
+    bool failed = false;  // 目标块非空，跳过
+};
+
+// total 在 below 以下的最高一位 (没有时返回 -1)
+int next_level(int64_t total, int below) {
+    for (int lvl = below - 1; lvl >= 0; --lvl) {
+        if ((total >> lvl) & 1) return lvl;
+    }
+    return -1;
+}
+
+const size_t kQueueCapacity = 64;
+
+}  // namespace
+
+bool bulk_load(const CRS& crs, Storage* storage, const std::string& path,
+               int num_threads, BulkLoadStats* stats, size_t max_open_bytes) {
+    auto t0 = std::chrono::steady_clock::now();
+
+    RegLogReader reader(path);
+    if (!reader.ok()) return false;
+    if (reader.blockSize() != crs.n) {
+        std::cerr << "[BulkLoad] Log block size " << reader.blockSize()
+                  << " does not match CRS n=" << crs.n << std::endl;
+        return false;
+    }
+    const int64_t n = crs.n;
+    const int64_t num_blocks = (crs.N + n - 1) / n;
+    const uint64_t records = reader.recordCount();
+
+    // 块按编号切成若干段，每段的累加缓冲 (每块 n 个点) 不超过 max_open_bytes
+    if (num_threads < 1) num_threads = 1;
+    const int64_t range_blocks = std::max<int64_t>(
+        num_threads, (int64_t)(max_open_bytes / (n * sizeof(G1))));
+    const int64_t num_ranges = (num_blocks + range_blocks - 1) / range_blocks;
+
+    // --- 第一遍：只读 id，数出每块最终的用户数，并按块段给记录分组 ---
+    // 要导入的记录 (id 合法且第一次出现) 的下标按所在的块段存放
+    std::vector<int64_t> totals(num_blocks, 0);
+    std::vector<bool> seen(crs.N, false);
+    std::vector<std::vector<uint64_t>> ranges(num_ranges);
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < records; ++i) {
+        int64_t id = reader.idAt(i);
+        if (id < 0 || id >= crs.N || seen[id]) continue;
+        seen[id] = true;
+        totals[id / n]++;
+        ranges[id / n / range_blocks].push_back(i);
+        kept++;
+    }
+    std::vector<bool>().swap(seen);
+
+    // --- 第二遍：一次一个块段，读线程按块分发，工作线程累加并写层 ---
+    std::vector<std::unique_ptr<PayloadQueue>> queues;
+    for (int t = 0; t < num_threads; ++t) {
+        queues.emplace_back(new PayloadQueue(kQueueCapacity));
+    }
+
+    BlockLocks locks;
+    std::atomic<uint64_t> loaded(0);
+    std::atomic<bool> ok(true);
+
+    auto worker = [&](int t) {
+        G1 zero;
+        zero.clear();
+        std::unordered_map<int64_t, OpenBlock> open;
+        std::string payload;
+        RegRequest r;
+
+        while (queues[t]->pop(payload)) {
+            int64_t id;
+            std::memcpy(&id, payload.data(), sizeof(id));
+            int64_t k = id / n;
+
+            auto it = open.find(k);
+            if (it == open.end()) {
+                OpenBlock& b = open[k];
+                b.total = totals[k];
+                b.level = next_level(b.total, 63);
+                b.com = zero;
+                b.aux.assign(n, zero);
+
+                // 目标块必须是空的
+                Storage* st = storage->storageForBlock(k);
+                std::lock_guard<std::mutex> guard(locks.lockFor(st, k));
+                if (st->getBlockUserCount(k) != 0 ||
+                    pending_groups(crs, st, k) != 0) {
+                    std::cerr << "[BulkLoad] Block " << k
+                              << " is not empty, skipped" << std::endl;
+                    b.failed = true;
+                    b.aux.clear();
+                    ok = false;
+                }
+                it = open.find(k);
+            }
+            OpenBlock& b = it->second;
+            b.placed++;
+
+            if (!b.failed && !reader.decode(payload, r)) {
+                std::cerr << "[BulkLoad] Malformed record for id " << id
+                          << ", block " << k << " skipped" << std::endl;
+                b.failed = true;
+                b.aux.clear();
+                b.pks.clear();
+                ok = false;
+            }
+            if (!b.failed) {
+                int64_t id_rel = r.id % n;
+                G1::add(b.com, b.com, r.pk);
+                for (int64_t i = 0; i < n; ++i) {
+                    // 用户不给自己的位置贡献辅助值
+                    if (i == id_rel) continue;
+                    G1::add(b.aux[i], b.aux[i], r.xi[i]);
+                }
+                b.pks.emplace_back(r.id, r.pk);
+                b.filled++;
+
+                // 本层装满：写下去，转到下一层
+                if (b.filled == ((int64_t)1 << b.level)) {
+                    Storage* st = storage->storageForBlock(k);
+                    std::lock_guard<std::mutex> guard(locks.lockFor(st, k));
+                    StorageBatch batch(st);
+                    for (const auto& p : b.pks) {
+                        st->saveUserPublicKey(p.first, p.second);
+                    }
+                    st->savePPCommitment(k, b.level, b.com);
+                    st->setUserCountInLevel(k, b.level, 1);
+                    st->saveAuxVector(k, b.level, b.aux);
+                    if (b.placed == b.total) st->setBlockUserCount(k, b.total);
+                    if (batch.commit()) {
+                        loaded += b.pks.size();
+                        if (rbe_verbose)
+                            std::cout << "[BulkLoad] Block " << k << " Level "
+                                      << b.level << " <- " << b.filled
+                                      << " users" << std::endl;
+                    } else {
+                        std::cerr << "[BulkLoad] Storage batch failed, block "
+                                  << k << " level " << b.level
+                                  << " not written" << std::endl;
+                        b.failed = true;
+                        ok = false;
+                    }
+
+                    b.level = next_level(b.total, b.level);
+                    b.filled = 0;
+                    b.com = zero;
+                    for (G1& v : b.aux) v = zero;
+                    b.pks.clear();
+                }
+            }
+
+            if (b.placed == b.total) open.erase(it);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) threads.emplace_back(worker, t);
+
+    // 段内的块在这一段的记录读完时就都写完了，同时打开的块不超过一段
+    // (加上队列里滞后的少量记录)；段内记录按文件偏移递增读取
+    std::string payload;
+    for (const std::vector<uint64_t>& range : ranges) {
+        for (uint64_t index : range) {
+            if (!reader.payloadAt(index, payload)) {
+                std::cerr << "[BulkLoad] Corrupt record #" << index << " in "
+                          << path << ", aborting" << std::endl;
+                ok = false;
+                break;
+            }
+            int64_t id;
+            std::memcpy(&id, payload.data(), sizeof(id));
+            queues[(id / n) % num_threads]->push(std::move(payload));
+        }
+        if (reader.corrupt()) break;
+    }
+    for (auto& q : queues) q->close();
+    for (std::thread& t : threads) t.join();
+
+    if (stats) {
+        stats->records = records;
+        stats->loaded = loaded;
+        stats->skipped = records - kept;
+        stats->blocks = 0;
+        for (int64_t total : totals) stats->blocks += total > 0;
+        stats->seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - t0)
+                             .count();
+    }
+    return ok;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <RBE_Common.h>
+#include <Storage.h>
+
+#include <cstdint>
+#include <string>
+
+// 批量导入的统计
+struct BulkLoadStats {
+    uint64_t records = 0;     // 日志里的记录数
+    uint64_t loaded = 0;      // 实际注册的用户数
+    uint64_t skipped = 0;     // 重复 / 越界 (id >= N) 的记录
+    int64_t blocks = 0;       // 写入的块数
+    double seconds = 0;
+};
+
+// ---------------------------------------------------------
+// 批量导入：把 RegJournal 格式的注册日志 (id, pk, xi) 一次性装进空的存储，
+// 用于冷启动或迁移，结果与按日志顺序逐个 reg 相同 (重复的 id 只取第一次)。
+//
+//   1. 第一遍只按偏移读每条记录的 id，数出每块最终的用户数 total，
+//      同时把要导入的记录按块段 (连续的若干块) 分组，只记下标；
+//   2. 块的最终布局就是 total 的二进制表示，各层按层号从高到低恰好是
+//      注册先后 (见 reg_batch 的说明)。第二遍一次处理一个块段：按下标读出
+//      该段的记录，每个用户只累加进它所在的那一层；一层装满就写下去，
+//      每块同一时刻只有一个未满的层，一段读完时段内的块都已写完；
+//   3. 块按 k % num_threads 分给各工作线程，累加在多个核上并行；写存储时
+//      按块加锁 (BlockLocks)，每写一层一个 StorageBatch。
+//
+// 代价是每个用户 n 次点加法加上顺序读日志，不做合并级联。
+// 要求目标块是空的 (没有已落座的用户和暂存组)，否则跳过该块并返回 false。
+// 日志是 curator 写的可信数据 (点在入口处已经校验过，见 RegJournal)，
+// 按 g1vec_deserialize 还原，不再逐点做子群检查；xi 与 pk 是否匹配也不检查。
+// 遇到损坏的记录、或存储的批次失败 (见 Storage::batchFailed) 时跳过该块
+// 并返回 false，已经写下去的块可能不完整。
+// 内存：每个未写完的块缓存一个长度为 n 的辅助值向量和该层用户的公钥。
+// 块段的大小按这部分内存的上限 max_open_bytes 定 (至少 num_threads 个块)，
+// 日志不论按什么顺序排列，同时打开的块都不超过一段；另外每条记录在第一遍
+// 里占 8 字节的下标。
+// ---------------------------------------------------------
+bool bulk_load(const CRS& crs, Storage* storage, const std::string& path,
+               int num_threads, BulkLoadStats* stats = nullptr,
+               size_t max_open_bytes = 256 << 20);
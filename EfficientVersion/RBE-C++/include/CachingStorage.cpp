@@ -0,0 +1,466 @@
+#include <CachingStorage.h>
+
+CachingStorage::CachingStorage(Storage* backend, int64_t n, size_t capacity,
+                               bool flush_on_commit)
+    : backend(backend),
+      n(n),
+      capacity(capacity == 0 ? 1 : capacity),
+      flush_on_commit(flush_on_commit) {}
+
+CachingStorage::~CachingStorage() {
+    if (!flush()) {
+        std::cerr << "[Cache] Final write-back failed, dirty data lost"
+                  << std::endl;
+    }
+}
+
+// --- LRU ---
+CachingStorage::Entry& CachingStorage::entry(int64_t block_index, int level) {
+    auto it = index.find(key(block_index, level));
+    if (it != index.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return lru.front();
+    }
+
+    // 满了先淘汰最久未用的条目
+    evictTo(capacity - 1);
+
+    lru.emplace_front();
+    Entry& e = lru.front();
+    e.block_index = block_index;
+    e.level = level;
+    e.com.clear();
+    index[key(block_index, level)] = lru.begin();
+    // 批次内新建的条目回滚时丢掉
+    remember(e);
+    return e;
+}
+
+void CachingStorage::evictTo(size_t limit) {
+    while (lru.size() > limit) {
+        Entry& victim = lru.back();
+        if (victim.dirty()) {
+            // 脏数据整体写回 (见类说明)，之后 victim 就是干净的了。
+            // 后端没能提交时脏数据还在缓存里，先不淘汰
+            if (!writeBackInBatch()) {
+                std::cerr << "[Cache] Write-back failed, keeping "
+                          << lru.size() << " entries" << std::endl;
+                return;
+            }
+        }
+        index.erase(key(victim.block_index, victim.level));
+        lru.pop_back();
+        cache_stats.evictions++;
+    }
+}
+
+// --- 回滚记录 ---
+void CachingStorage::remember(Entry& e) {
+    if (batch_depth == 0) return;
+    uint64_t k = key(e.block_index, e.level);
+    if (undo.count(k)) return;
+    Undo& u = undo[k];
+    u.keep = e.dirty();
+    if (u.keep) u.saved = e;
+}
+
+void CachingStorage::rememberCheckpoint() {
+    if (batch_depth == 0 || checkpoint_saved) return;
+    checkpoint_saved = true;
+    checkpoint_undo = checkpoint;
+}
+
+void CachingStorage::endBatch(bool failed) {
+    restoreBatch(failed);
+    // 恢复的条目可能超出容量
+    evictTo(capacity);
+}
+
+void CachingStorage::restoreBatch(bool failed) {
+    if (failed) {
+        for (auto& entry_undo : undo) {
+            auto it = index.find(entry_undo.first);
+            if (it != index.end()) {
+                lru.erase(it->second);
+                index.erase(it);
+            }
+            if (entry_undo.second.keep) {
+                lru.push_front(std::move(entry_undo.second.saved));
+                index[entry_undo.first] = lru.begin();
+            }
+        }
+        // 公钥：先放回批次内写回过的，再撤销本批次的新增与覆盖
+        for (auto& pk : pk_written) pending_pks[pk.first] = pk.second;
+        for (int64_t id : pk_added) pending_pks.erase(id);
+        for (auto& pk : pk_replaced) pending_pks[pk.first] = pk.second;
+        if (checkpoint_saved) checkpoint = checkpoint_undo;
+    }
+    undo.clear();
+    pk_added.clear();
+    pk_replaced.clear();
+    pk_written.clear();
+    checkpoint_saved = false;
+}
+
+bool CachingStorage::writeBackInBatch() {
+    bool outermost = batch_depth == 0;
+    batch_depth++;  // 让 writeBack 记下回滚信息
+    StorageBatch batch(backend);
+    if (batch.ok()) writeBackAll();
+    bool ok = batch.commit();
+    batch_depth--;
+    if (outermost) {
+        restoreBatch(!ok);
+    } else if (!ok) {
+        batch_failed = true;  // 外层批次结束时一起恢复
+    }
+    return ok;
+}
+
+void CachingStorage::loadCount(Entry& e) {
+    if (e.count_known) {
+        cache_stats.hits++;
+        return;
+    }
+    cache_stats.misses++;
+    e.count = backend->getUserCountInLevel(e.block_index, e.level);
+    e.count_known = true;
+    // 计数为 0 的层约定没有承诺也没有 Aux
+    if (e.count == 0 && !e.dirty()) e.backend_empty = true;
+}
+
+void CachingStorage::loadCom(Entry& e) {
+    if (e.com_known) {
+        cache_stats.hits++;
+        return;
+    }
+    cache_stats.misses++;
+    e.com = backend->getPPCommitment(e.block_index, e.level);
+    e.com_known = true;
+}
+
+void CachingStorage::loadAux(Entry& e) {
+    if (e.aux_known) {
+        cache_stats.hits++;
+        return;
+    }
+    cache_stats.misses++;
+    e.aux = backend->getAuxVector(e.block_index, e.level);
+    e.aux_present = !e.aux.empty();
+    e.aux_known = true;
+}
+
+// --- 写回 ---
+void CachingStorage::writeBack(Entry& e) {
+    // 写回之后条目变干净，回滚时要知道它原来是脏的
+    remember(e);
+    if (e.level == kBlockCountLevel) {
+        backend->setBlockUserCount(e.block_index, e.count);
+        e.count_dirty = false;
+        cache_stats.writes++;
+        return;
+    }
+    bool wrote_data = false;
+
+    if (e.com_dirty) {
+        if (e.com.isZero()) {
+            if (e.backend_empty) {
+                cache_stats.coalesced++;
+            } else {
+                backend->deletePPCommitment(e.block_index, e.level);
+                cache_stats.writes++;
+            }
+        } else {
+            backend->savePPCommitment(e.block_index, e.level, e.com);
+            cache_stats.writes++;
+            wrote_data = true;
+        }
+        e.com_dirty = false;
+    }
+
+    if (e.aux_dirty) {
+        if (!e.aux_present) {
+            if (e.backend_empty) {
+                cache_stats.coalesced++;
+            } else {
+                backend->deleteAuxVector(e.block_index, e.level);
+                cache_stats.writes++;
+            }
+        } else {
+            backend->saveAuxVector(e.block_index, e.level, e.aux);
+            cache_stats.writes++;
+            wrote_data = true;
+        }
+        e.aux_dirty = false;
+    }
+
+    if (e.count_dirty) {
+        if (e.count == 0 && e.backend_empty) {
+            cache_stats.coalesced++;
+        } else {
+            backend->setUserCountInLevel(e.block_index, e.level, e.count);
+            cache_stats.writes++;
+            wrote_data = wrote_data || e.count != 0;
+        }
+        e.count_dirty = false;
+    }
+
+    if (wrote_data) {
+        e.backend_empty = false;
+    } else if (e.count_known && e.count == 0 && e.com_known &&
+               e.com.isZero() && e.aux_known && !e.aux_present) {
+        e.backend_empty = true;
+    }
+}
+
+void CachingStorage::writeBackAll() {
+    for (Entry& e : lru) {
+        if (e.dirty()) writeBack(e);
+    }
+    for (auto& pk : pending_pks) {
+        backend->saveUserPublicKey(pk.first, pk.second);
+        cache_stats.writes++;
+        // 批次内写回的公钥在回滚时要放回 pending_pks
+        if (batch_depth > 0) pk_written.insert(pk);
+    }
+    pending_pks.clear();
+    if (checkpoint.dirty) {
+        rememberCheckpoint();
+        backend->setJournalCheckpoint(checkpoint.seq);
+        checkpoint.dirty = false;
+        cache_stats.writes++;
+    }
+}
+
+bool CachingStorage::anyDirty() const {
+    if (!pending_pks.empty() || checkpoint.dirty) return true;
+    for (const Entry& e : lru) {
+        if (e.dirty()) return true;
+    }
+    return false;
+}
+
+bool CachingStorage::flush() {
+    if (!anyDirty()) return true;
+    return writeBackInBatch();
+}
+
+bool CachingStorage::clear() {
+    // 写回失败时不清空，脏数据不能丢
+    if (!flush()) return false;
+    invalidate();
+    return true;
+}
+
+void CachingStorage::invalidate() {
+    lru.clear();
+    index.clear();
+    pending_pks.clear();
+    checkpoint = Checkpoint();
+}
+
+// --- 用户 ---
+bool CachingStorage::isUserRegistered(int64_t id) {
+    return pending_pks.count(id) || backend->isUserRegistered(id);
+}
+
+void CachingStorage::saveUserPublicKey(int64_t id, const G1& pk) {
+    auto it = pending_pks.find(id);
+    if (batch_depth > 0) {
+        if (it == pending_pks.end()) {
+            pk_added.push_back(id);
+        } else if (!pk_replaced.count(id)) {
+            pk_replaced[id] = it->second;
+        }
+    }
+    pending_pks[id] = pk;
+}
+
+G1 CachingStorage::getUserPublicKey(int64_t id) {
+    auto it = pending_pks.find(id);
+    if (it != pending_pks.end()) return it->second;
+    return backend->getUserPublicKey(id);
+}
+
+// --- PP ---
+G1 CachingStorage::getPPCommitment(int64_t block_index, int level) {
+    Entry& e = entry(block_index, level);
+    loadCom(e);
+    return e.com;
+}
+
+void CachingStorage::savePPCommitment(int64_t block_index, int level,
+                                      const G1& com) {
+    Entry& e = entry(block_index, level);
+    remember(e);
+    e.com = com;
+    e.com_known = true;
+    e.com_dirty = true;
+}
+
+void CachingStorage::deletePPCommitment(int64_t block_index, int level) {
+    Entry& e = entry(block_index, level);
+    remember(e);
+    e.com.clear();
+    e.com_known = true;
+    e.com_dirty = true;
+}
+
+// --- Aux 单行：在缓存的整向量上操作 ---
+G1 CachingStorage::getAuxUpdate(int64_t row_id, int level) {
+    Entry& e = entry(row_id / n, level);
+    loadAux(e);
+    if (!e.aux_present) {
+        G1 zero;
+        zero.clear();
+        return zero;
+    }
+    return e.aux[row_id % n];
+}
+
+void CachingStorage::saveAuxUpdate(int64_t row_id, int level, const G1& upd) {
+    Entry& e = entry(row_id / n, level);
+    remember(e);
+    loadAux(e);
+    if (!e.aux_present) {
+        e.aux.resize(n);
+        for (G1& p : e.aux) p.clear();
+        e.aux_present = true;
+    }
+    e.aux[row_id % n] = upd;
+    e.aux_dirty = true;
+}
+
+void CachingStorage::deleteAuxUpdate(int64_t row_id, int level) {
+    Entry& e = entry(row_id / n, level);
+    remember(e);
+    loadAux(e);
+    if (!e.aux_present) return;
+    e.aux[row_id % n].clear();
+    e.aux_dirty = true;
+}
+
+// --- Aux 整向量 ---
+std::vector<G1> CachingStorage::getAuxVector(int64_t block_index, int level) {
+    Entry& e = entry(block_index, level);
+    loadAux(e);
+    if (!e.aux_present) return {};
+    return e.aux;
+}
+
+bool CachingStorage::readAuxVector(int64_t block_index, int level,
+                                   std::vector<G1>& out) {
+    Entry& e = entry(block_index, level);
+    loadAux(e);
+    if (!e.aux_present) return false;
+    out.assign(e.aux.begin(), e.aux.end());
+    return true;
+}
+
+void CachingStorage::saveAuxVector(int64_t block_index, int level,
+                                   const std::vector<G1>& vec) {
+    Entry& e = entry(block_index, level);
+    remember(e);
+    e.aux = vec;
+    e.aux_present = true;
+    e.aux_known = true;
+    e.aux_dirty = true;
+}
+
+void CachingStorage::deleteAuxVector(int64_t block_index, int level) {
+    Entry& e = entry(block_index, level);
+    remember(e);
+    e.aux.clear();
+    e.aux_present = false;
+    e.aux_known = true;
+    e.aux_dirty = true;
+}
+
+// --- 计数器 ---
+int64_t CachingStorage::getUserCountInLevel(int64_t block_index, int level) {
+    Entry& e = entry(block_index, level);
+    loadCount(e);
+    return e.count;
+}
+
+void CachingStorage::setUserCountInLevel(int64_t block_index, int level,
+                                         int64_t count) {
+    Entry& e = entry(block_index, level);
+    remember(e);
+    e.count = count;
+    e.count_known = true;
+    e.count_dirty = true;
+}
+
+int64_t CachingStorage::getBlockUserCount(int64_t block_index) {
+    Entry& e = entry(block_index, kBlockCountLevel);
+    if (e.count_known) {
+        cache_stats.hits++;
+        return e.count;
+    }
+    cache_stats.misses++;
+    e.count = backend->getBlockUserCount(block_index);
+    e.count_known = true;
+    return e.count;
+}
+
+void CachingStorage::setBlockUserCount(int64_t block_index, int64_t count) {
+    Entry& e = entry(block_index, kBlockCountLevel);
+    remember(e);
+    e.count = count;
+    e.count_known = true;
+    e.count_dirty = true;
+}
+
+bool CachingStorage::hasAux(int64_t row_id, int level) {
+    Entry& e = entry(row_id / n, level);
+    loadAux(e);
+    return e.aux_present;
+}
+
+// --- 注册日志的检查点 ---
+uint64_t CachingStorage::getJournalCheckpoint() {
+    if (!checkpoint.known) {
+        checkpoint.seq = backend->getJournalCheckpoint();
+        checkpoint.known = true;
+    }
+    return checkpoint.seq;
+}
+
+void CachingStorage::setJournalCheckpoint(uint64_t seq) {
+    rememberCheckpoint();
+    checkpoint.seq = seq;
+    checkpoint.known = true;
+    checkpoint.dirty = true;
+}
+
+// --- 批处理 ---
+void CachingStorage::beginBatch() {
+    if (batch_depth++ == 0) batch_failed = false;
+    backend->beginBatch();
+}
+
+void CachingStorage::commitBatch() {
+    if (batch_depth == 0) return;
+    if (batch_depth == 1 && flush_on_commit && !batchFailed()) {
+        // 脏数据写进后端当前这个 (最外层) 事务，再一起提交
+        writeBackAll();
+    }
+    batch_depth--;
+    backend->commitBatch();
+    // 后端的事务没能开始或没能提交：缓存里的修改也一起撤销
+    if (backend->batchFailed()) batch_failed = true;
+    if (batch_depth == 0) endBatch(batch_failed);
+}
+
+bool CachingStorage::batchFailed() const {
+    return batch_failed || (batch_depth > 0 && backend->batchFailed());
+}
+
+void CachingStorage::rollbackBatch() {
+    if (batch_depth == 0) return;
+    batch_failed = true;
+    batch_depth--;
+    backend->rollbackBatch();
+    if (batch_depth == 0) endBatch(true);
+}
@@ -0,0 +1,198 @@
+#pragma once
+#include <Storage.h>
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+// ---------------------------------------------------------
+// 带写回缓存的 Storage 装饰器，可以包在任意后端 (例如 SQLiteStorage) 外面，
+// 后端本身不需要任何修改。
+//
+// 缓存单位是一个 (块, 层)：承诺、计数、整条 Aux 向量都以解码后的 G1
+// 形式保存；每块的用户数也作为一个条目 (伪层号 kBlockCountLevel)。
+// 容量按条目数计，满了按 LRU 淘汰。
+//   - enc / upd 按层读取、reg 在合并级联里回读刚写入的层，都直接命中缓存；
+//   - 写入只改缓存并标脏；最外层批次提交时 (或显式 flush 时) 才写回后端，
+//     同一层在一个批次内反复写入只落盘最后一次。如果后端本来就没有这一层，
+//     "写入后又被删除" 的层根本不会到达后端。
+//   - 用户公钥、注册日志的检查点也先留在缓存里，和层数据一起写回。
+//   - 写回的单位是全部脏数据 (各层、块用户数、公钥) 在后端的一个事务里，
+//     淘汰一个脏条目时也是整体写回：后端里不会出现公钥已落盘、层数据
+//     却还没写下去的中间状态。
+//
+// 批处理：beginBatch / commitBatch 透传给后端。flush_on_commit 为 true 时
+// (默认)，最外层提交前先把脏数据写进后端的同一个事务；为 false 时脏数据
+// 一直留在缓存里，直到 flush / 淘汰 / 析构，合并写入的范围更大。
+// 回滚只撤销本批次的修改：批次内第一次修改 (或写回、淘汰) 某个条目前
+// 记下它原来的状态，回滚时恢复；之前已提交、还没写回的脏数据保留。
+//
+// 不是线程安全的。
+// ---------------------------------------------------------
+class CachingStorage : public Storage {
+   public:
+    struct Stats {
+        uint64_t hits = 0;       // 命中缓存的读取
+        uint64_t misses = 0;     // 需要访问后端的读取
+        uint64_t evictions = 0;  // 被 LRU 淘汰的条目
+        uint64_t writes = 0;     // 真正写回后端的次数
+        uint64_t coalesced = 0;  // 因合并而省掉的写回次数
+    };
+
+    // backend: 被包装的后端 (不持有所有权)
+    // n: 块大小，用于把 row_id 换算成 (块, 位置)
+    // capacity: 最多缓存的 (块, 层) 条目数
+    CachingStorage(Storage* backend, int64_t n, size_t capacity = 256,
+                   bool flush_on_commit = true);
+    ~CachingStorage();
+
+    CachingStorage(const CachingStorage&) = delete;
+    CachingStorage& operator=(const CachingStorage&) = delete;
+
+    // 把所有脏条目写回后端 (条目仍保留在缓存中)。
+    // 后端没能提交时返回 false，脏数据仍留在缓存里
+    bool flush();
+    // 写回并清空缓存；写回失败时不清空，返回 false
+    bool clear();
+
+    const Stats& stats() const { return cache_stats; }
+    void resetStats() { cache_stats = Stats(); }
+
+    bool isUserRegistered(int64_t id) override;
+    void saveUserPublicKey(int64_t id, const G1& pk) override;
+    G1 getUserPublicKey(int64_t id) override;
+
+    G1 getPPCommitment(int64_t block_index, int level) override;
+    void savePPCommitment(int64_t block_index, int level,
+                          const G1& com) override;
+    void deletePPCommitment(int64_t block_index, int level) override;
+
+    G1 getAuxUpdate(int64_t row_id, int level) override;
+    void saveAuxUpdate(int64_t row_id, int level, const G1& upd) override;
+    void deleteAuxUpdate(int64_t row_id, int level) override;
+
+    std::vector<G1> getAuxVector(int64_t block_index, int level) override;
+    void saveAuxVector(int64_t block_index, int level,
+                       const std::vector<G1>& vec) override;
+    void deleteAuxVector(int64_t block_index, int level) override;
+    bool readAuxVector(int64_t block_index, int level,
+                       std::vector<G1>& out) override;
+
+    int64_t getUserCountInLevel(int64_t block_index, int level) override;
+    void setUserCountInLevel(int64_t block_index, int level,
+                             int64_t count) override;
+
+    int64_t getBlockUserCount(int64_t block_index) override;
+    void setBlockUserCount(int64_t block_index, int64_t count) override;
+
+    bool hasAux(int64_t row_id, int level) override;
+
+    uint64_t getJournalCheckpoint() override;
+    void setJournalCheckpoint(uint64_t seq) override;
+
+    void beginBatch() override;
+    void commitBatch() override;
+    void rollbackBatch() override;
+    bool batchFailed() const override;
+
+   private:
+    // 一个 (块, 层) 的缓存内容。每个分量单独记录是否已知 (已从后端加载
+    // 或已被写入) 以及是否为脏
+    struct Entry {
+        int64_t block_index;
+        int level;
+
+        bool count_known = false, count_dirty = false;
+        int64_t count = 0;
+
+        bool com_known = false, com_dirty = false;
+        G1 com;  // 零元表示该层没有承诺
+
+        bool aux_known = false, aux_dirty = false;
+        bool aux_present = false;
+        std::vector<G1> aux;
+
+        // 确认后端里这一层是空的 (读到计数为 0，或刚写回过删除)
+        bool backend_empty = false;
+
+        bool dirty() const { return count_dirty || com_dirty || aux_dirty; }
+    };
+    typedef std::list<Entry> EntryList;
+
+    // 块用户数条目的伪层号 (真实的层号都小于它)
+    static const int kBlockCountLevel = 255;
+
+    // 条目在最外层批次开始时的状态。那时是干净的条目 (或者还没有) 只需在
+    // 回滚时丢掉，后端里就是它的内容；脏的条目要留一份副本
+    struct Undo {
+        bool keep;    // 回滚时恢复 saved；否则丢弃该条目
+        Entry saved;
+    };
+
+    Storage* backend;
+    int64_t n;
+    size_t capacity;
+    bool flush_on_commit;
+    int batch_depth = 0;
+    // 本批次内有过回滚或后端失败，最外层结束时整体撤销
+    // (批次外时表示刚结束的批次是否失败)
+    bool batch_failed = false;
+
+    EntryList lru;  // 最近使用的在前
+    std::unordered_map<uint64_t, EntryList::iterator> index;
+
+    // 还没写回的用户公钥
+    std::unordered_map<int64_t, G1> pending_pks;
+
+    // 注册日志的检查点
+    struct Checkpoint {
+        bool known = false, dirty = false;
+        uint64_t seq = 0;
+    };
+    Checkpoint checkpoint;
+
+    // 回滚用：本批次改过的条目的原状态，按 key 记录第一次
+    std::unordered_map<uint64_t, Undo> undo;
+    // 回滚用：本批次新加入 pending_pks 的 id、被覆盖的旧公钥，
+    // 以及批次内写回 (从 pending_pks 移走) 的公钥
+    std::vector<int64_t> pk_added;
+    std::unordered_map<int64_t, G1> pk_replaced;
+    std::unordered_map<int64_t, G1> pk_written;
+    // 回滚用：检查点在批次开始时的状态
+    bool checkpoint_saved = false;
+    Checkpoint checkpoint_undo;
+
+    Stats cache_stats;
+
+    // 层数不超过 log2(N) + 3 < 256，低 8 位放层号，其余放块号
+    static uint64_t key(int64_t block_index, int level) {
+        return ((uint64_t)block_index << 8) | (uint8_t)level;
+    }
+
+    // 取 (块, 层) 的条目并移到 LRU 前端，不存在时新建 (可能触发淘汰)
+    Entry& entry(int64_t block_index, int level);
+    // 淘汰到最多剩 limit 个条目
+    void evictTo(size_t limit);
+    // 批次内修改条目前调用，记下它在批次开始时的状态
+    void remember(Entry& e);
+    // 批次内修改检查点前调用，记下它在批次开始时的状态
+    void rememberCheckpoint();
+    // 最外层批次结束：失败时恢复批次开始时的状态，然后清空回滚记录
+    void endBatch(bool failed);
+    // endBatch 去掉最后的淘汰
+    void restoreBatch(bool failed);
+    // 按需从后端加载各分量
+    void loadCount(Entry& e);
+    void loadCom(Entry& e);
+    void loadAux(Entry& e);
+    // 把一个条目的脏分量写回后端
+    void writeBack(Entry& e);
+    // 写回全部脏条目与待写的公钥 (调用方负责包在后端批次里)
+    void writeBackAll();
+    // 在后端的一个批次里 writeBackAll；后端没能提交时条目恢复成写回前的
+    // 脏状态，返回 false
+    bool writeBackInBatch();
+    bool anyDirty() const;
+    // 丢弃全部缓存 (不写回)
+    void invalidate();
+};
@@ -0,0 +1,218 @@
+#include <ConcurrentRegistrar.h>
+#include <PointDecoder.h>
+#include <RegJournal.h>
+
+#include <algorithm>
+#include <atomic>
+
+std::mutex& BlockLocks::lockFor(Storage* st, int64_t block_index) {
+    if (st->isConcurrencySafe()) {
+        return stripes[(size_t)block_index % stripes.size()];
+    }
+    std::lock_guard<std::mutex> guard(storage_locks_mutex);
+    std::unique_ptr<std::mutex>& lock = storage_locks[st];
+    if (!lock) lock.reset(new std::mutex());
+    return *lock;
+}
+
+ConcurrentRegistrar::ConcurrentRegistrar(const CRS& crs, Storage* storage,
+                                         size_t num_stripes)
+    : crs(crs), storage(storage), locks(num_stripes) {}
+
+ConcurrentRegistrar::~ConcurrentRegistrar() {
+    if (!compactor.joinable()) return;
+    {
+        std::lock_guard<std::mutex> guard(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    compactor.join();
+}
+
+void ConcurrentRegistrar::enableDeferredMerge(int max_pending_per_block) {
+    if (compactor.joinable() || max_pending_per_block <= 0) return;
+    max_pending = std::min(max_pending_per_block, kRbePendingGroups);
+
+    // 找出上次留下、还没合并的组
+    int64_t num_blocks = (crs.N + crs.n - 1) / crs.n;
+    for (int64_t k = 0; k < num_blocks; ++k) {
+        Storage* st = storage->storageForBlock(k);
+        std::lock_guard<std::mutex> guard(locks.lockFor(st, k));
+        if (pending_groups(crs, st, k) != 0) queue.insert(k);
+    }
+    compactor = std::thread(&ConcurrentRegistrar::compactorLoop, this);
+}
+
+bool ConcurrentRegistrar::reg(int64_t id, const G1& pk,
+                              const std::vector<G1>& helping_values) {
+    if (verify && !verify_helping_values(crs, id, pk, helping_values)) {
+        std::cerr << "[Reg] Rejected id " << id << ": bad helping values"
+                  << std::endl;
+        return false;
+    }
+    return regChecked(id, pk, helping_values);
+}
+
+bool ConcurrentRegistrar::regWire(const char* data, size_t bytes, int mode) {
+    {
+        std::lock_guard<std::mutex> guard(decoder_mutex);
+        if (!decoder) {
+            int threads = (int)std::thread::hardware_concurrency();
+            decoder.reset(new PointDecoder(threads));
+        }
+    }
+    RegRequest r;
+    if (!decoder->decodeRequest(data, bytes, crs.n, mode, r)) {
+        std::cerr << "[Reg] Rejected wire request: " << bytes
+                  << " bytes, bad length or point encoding" << std::endl;
+        return false;
+    }
+    return reg(r.id, r.pk, r.xi);
+}
+
+bool ConcurrentRegistrar::regChecked(int64_t id, const G1& pk,
+                                     const std::vector<G1>& helping_values) {
+    uint64_t seq = 0;
+    if (journal) {
+        seq = journal->append({id, pk, helping_values});
+        if (seq == 0) return false;
+        // 等日志落盘时不持有块锁，其他线程的记录可以搭同一次 fsync
+        journal->waitDurable(seq);
+    }
+
+    int64_t k = id / crs.n;
+    Storage* st = storage->storageForBlock(k);
+    std::lock_guard<std::mutex> guard(locks.lockFor(st, k));
+
+    // 检查点和本次注册在同一个批次里提交，所以可以包括本条记录
+    StorageBatch batch(st);
+    if (journal) st->setJournalCheckpoint(journal->checkpointFor(seq, seq));
+    bool deferred = false;
+    if (max_pending == 0) {
+        ::reg(crs, st, id, pk, helping_values);
+    } else {
+        // 暂存层满了时 reg_deferred 自己先合并 (反压)
+        deferred =
+            reg_deferred(crs, st, id, pk, helping_values, max_pending) != 0;
+    }
+    if (!batch.commit()) {
+        // 存储没能提交：不推进日志的应用进度，记录留给 recover_from_journal
+        std::cerr << "[Reg] Storage batch failed, id " << id
+                  << " not registered" << std::endl;
+        return false;
+    }
+    if (journal) journal->markApplied(seq);
+
+    if (deferred) {
+        {
+            std::lock_guard<std::mutex> q(queue_mutex);
+            queue.insert(k);
+        }
+        queue_cv.notify_one();
+    }
+    return true;
+}
+
+size_t ConcurrentRegistrar::reg_parallel(
+    const std::vector<RegRequest>& requests, int num_threads) {
+    if (num_threads < 1) num_threads = 1;
+
+    // 开启校验时先把请求切成 num_threads 段，各段整批校验
+    std::vector<bool> accepted(requests.size(), true);
+    size_t rejected = 0;
+    if (verify) {
+        size_t per = (requests.size() + num_threads - 1) / num_threads;
+        auto check = [&](size_t begin) {
+            size_t end = std::min(begin + per, requests.size());
+            std::vector<RegRequest> slice(requests.begin() + begin,
+                                          requests.begin() + end);
+            std::vector<bool> ok = verify_reg_batch(crs, slice);
+            for (size_t i = begin; i < end; ++i) accepted[i] = ok[i - begin];
+        };
+        std::vector<std::thread> threads;
+        for (size_t b = per; b < requests.size(); b += per) {
+            threads.emplace_back(check, b);
+        }
+        if (!requests.empty()) check(0);
+        for (std::thread& t : threads) t.join();
+
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (accepted[i]) continue;
+            std::cerr << "[Reg] Rejected id " << requests[i].id
+                      << ": bad helping values" << std::endl;
+            rejected++;
+        }
+    }
+
+    // 按块分组，块内保持提交顺序
+    std::map<int64_t, std::vector<const RegRequest*>> by_block;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (!accepted[i]) continue;
+        by_block[requests[i].id / crs.n].push_back(&requests[i]);
+    }
+    std::vector<const std::vector<const RegRequest*>*> groups;
+    for (const auto& entry : by_block) groups.push_back(&entry.second);
+
+    // 各线程从同一个计数器领取下一个块
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failed(0);
+    auto worker = [&]() {
+        for (size_t g = next++; g < groups.size(); g = next++) {
+            for (const RegRequest* r : *groups[g]) {
+                if (!regChecked(r->id, r->pk, r->xi)) failed++;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) threads.emplace_back(worker);
+    worker();  // 当前线程也干活
+    for (std::thread& t : threads) t.join();
+    return rejected + failed;
+}
+
+// --- 延迟合并 ---
+void ConcurrentRegistrar::compactLocked(Storage* st, int64_t k) {
+    {
+        std::lock_guard<std::mutex> q(queue_mutex);
+        queue.erase(k);
+    }
+    compact_pending(crs, st, k);
+}
+
+void ConcurrentRegistrar::compactAll() {
+    while (true) {
+        int64_t k;
+        {
+            std::lock_guard<std::mutex> q(queue_mutex);
+            if (queue.empty()) return;
+            k = *queue.begin();
+        }
+        Storage* st = storage->storageForBlock(k);
+        std::lock_guard<std::mutex> guard(locks.lockFor(st, k));
+        compactLocked(st, k);
+    }
+}
+
+void ConcurrentRegistrar::compactorLoop() {
+    std::unique_lock<std::mutex> q(queue_mutex);
+    while (true) {
+        queue_cv.wait(q, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) return;  // stopping，且队列已清空
+        int64_t k = *queue.begin();
+        q.unlock();
+        // 先拿块锁再取队列，和 reg() 的加锁顺序一致
+        Storage* st = storage->storageForBlock(k);
+        {
+            std::lock_guard<std::mutex> guard(locks.lockFor(st, k));
+            compactLocked(st, k);
+        }
+        q.lock();
+    }
+}
+
+size_t ConcurrentRegistrar::pendingCount(int64_t block_index) {
+    Storage* st = storage->storageForBlock(block_index);
+    std::lock_guard<std::mutex> guard(locks.lockFor(st, block_index));
+    return (size_t)pending_groups(crs, st, block_index);
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <algos.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+class PointDecoder;
+class RegJournal;
+
+// ---------------------------------------------------------
+// 按块分条的锁：修改块 k 之前要持有 lockFor(st, k)，st 是
+// storage->storageForBlock(k)。
+//   - st 声明了 isConcurrencySafe() 时，锁第 k % stripes 条，
+//     不同块可以在多个线程里并行；
+//   - 否则整个存储对象共用一把锁。分片后端经 storageForBlock() 拆成各个
+//     分片，每个分片一把锁，不同分片仍然并行。
+// ---------------------------------------------------------
+class BlockLocks {
+    std::vector<std::mutex> stripes;
+
+    // 不支持并发的存储对象各自一把锁，第一次用到时创建
+    std::mutex storage_locks_mutex;
+    std::map<Storage*, std::unique_ptr<std::mutex>> storage_locks;
+
+   public:
+    explicit BlockLocks(size_t num_stripes = 64)
+        : stripes(num_stripes == 0 ? 1 : num_stripes) {}
+
+    BlockLocks(const BlockLocks&) = delete;
+    BlockLocks& operator=(const BlockLocks&) = delete;
+
+    std::mutex& lockFor(Storage* st, int64_t block_index);
+};
+
+// ---------------------------------------------------------
+// 线程安全的注册入口。
+// 不同块的注册只碰各自块的 pp / aux / counts，互不相干；同一块的注册
+// 必须串行 (合并级联要读写同一组层)。这里按块分条加锁 (见 BlockLocks)，
+// 一个 reg() 只持有一把锁，不会死锁。
+//
+// 延迟合并模式 (enableDeferredMerge)：reg() 只调用 reg_deferred 把新用户
+// 单独写成一个未合并的组，延迟固定；后台线程再用 compact_pending 把这些组
+// 并入二进制层 (LSM 风格的 compaction)，期间 enc / upd 照常工作。
+//   - 每块最多 max_pending 个未合并的组 (不超过 kRbePendingGroups)，
+//     满了 reg() 当场合并 (反压)；
+//   - 未合并的组连同辅助值都在存储里，后台线程只记录哪些块要合并、
+//     合并时从存储读输入。进程崩溃后重新 enableDeferredMerge 会扫描
+//     所有块，把留下的组继续合并完。
+//
+// 设置了注册日志 (setJournal) 时，reg() 先追加日志并等它落盘，再加块锁
+// 应用到存储；并发的 reg() 共享一次 fsync (组提交，见 RegJournal)。
+// 每次应用时把日志的检查点 (RegJournal::checkpointFor) 和注册一起提交，
+// 写在这一块所在的存储上 (storageForBlock)。
+// 开启辅助值校验 (setVerifyHelpingValues) 时，不合法的请求在写日志之前就被拒绝。
+// ---------------------------------------------------------
+class ConcurrentRegistrar {
+    const CRS& crs;
+    Storage* storage;
+    BlockLocks locks;
+    RegJournal* journal = nullptr;
+    bool verify = false;
+
+    // regWire 用的解码器，第一次用到时创建
+    std::mutex decoder_mutex;
+    std::unique_ptr<PointDecoder> decoder;
+
+    // --- 延迟合并 ---
+    int max_pending = 0;  // 0 表示关闭
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    // 有未合并的组、等待后台合并的块
+    std::set<int64_t> queue;
+    bool stopping = false;
+    std::thread compactor;
+
+    // 后台线程：逐块合并队列里的块，停止时先把队列清空
+    void compactorLoop();
+    // reg() 校验之后的部分，日志拒绝请求或存储批次失败时返回 false
+    bool regChecked(int64_t id, const G1& pk,
+                    const std::vector<G1>& helping_values);
+    // 合并块 k 的暂存组 (调用方已持有块 k 的锁)
+    void compactLocked(Storage* st, int64_t k);
+
+   public:
+    // storage: 被保护的存储 (不持有所有权)；num_stripes: 分条锁的条数
+    ConcurrentRegistrar(const CRS& crs, Storage* storage,
+                        size_t num_stripes = 64);
+    // 延迟合并模式下先停掉后台线程，并把剩余的暂存组合并完
+    ~ConcurrentRegistrar();
+
+    ConcurrentRegistrar(const ConcurrentRegistrar&) = delete;
+    ConcurrentRegistrar& operator=(const ConcurrentRegistrar&) = delete;
+
+    // 开启延迟合并模式并启动后台合并线程 (只能开启一次，须在注册前调用)。
+    // 存储里已有的未合并的组 (上次崩溃留下的) 一并排进合并队列
+    void enableDeferredMerge(int max_pending_per_block = kRbePendingGroups);
+
+    // 注册前先写进 journal (不持有所有权)；须在注册前、
+    // recover_from_journal 之后调用
+    void setJournal(RegJournal* j) { journal = j; }
+
+    // 注册前先校验辅助值 (verify_helping_values)，没通过的请求不注册、
+    // 也不写日志
+    void setVerifyHelpingValues(bool on) { verify = on; }
+
+    // 与 ::reg 相同，可以在任意线程里调用。
+    // 开启校验且辅助值没通过、日志拒绝了请求 (xi 长度不对)、或存储的批次
+    // 失败 (见 Storage::batchFailed) 时返回 false。后一种情况下记录已经在
+    // 日志里，下次 recover_from_journal 时补上
+    bool reg(int64_t id, const G1& pk, const std::vector<G1>& helping_values);
+
+    // 线上格式的注册请求：id i64 | pk | xi[n] (见 PointDecoder::decodeRequest)，
+    // 点的编码为 mode。先逐点解码校验 (这个 registrar 共用一个 PointDecoder，
+    // 按硬件线程数并行，各调用串行)，再与 reg() 相同。
+    // 长度不对或有不合法的点时不注册、不写日志，返回 false
+    bool regWire(const char* data, size_t bytes, int mode = SER_MODE);
+
+    // 用 num_threads 个线程注册一批请求：按块分组，每块交给一个线程按提交
+    // 顺序注册，所以结果与顺序调用 ::reg 完全相同。
+    // 开启校验时先整批校验一次 (verify_reg_batch)，返回被拒绝的请求数
+    // (含日志拒绝的、存储批次失败的)
+    size_t reg_parallel(const std::vector<RegRequest>& requests,
+                        int num_threads);
+
+    // 在当前线程里把所有暂存组合并完 (与后台线程并行也安全)
+    void compactAll();
+    // 块 block_index 还有多少个未合并的组 (每组一人)
+    size_t pendingCount(int64_t block_index);
+};
@@ -0,0 +1,121 @@
+#include <FixedBase.h>
+
+namespace {
+
+// 窗口上限：再大建表时间和内存都不划算
+const size_t kMaxWindow = 16;
+
+size_t g2_table_bytes(size_t bits, size_t w) {
+    return (bits + w - 1) / w * (size_t(1) << w) * sizeof(G2);
+}
+
+// 有符号窗口要多留一位给最后的进位
+size_t gt_window_count(size_t bits, size_t w) { return (bits + 1 + w - 1) / w; }
+
+size_t gt_table_bytes(size_t bits, size_t w) {
+    return gt_window_count(bits, w) * (size_t(1) << (w - 1)) * sizeof(GT);
+}
+
+// 预算内最大的窗口，连 w = 2 都放不下时返回 0
+template <class F>
+size_t pick_window(size_t bits, size_t budget, F table_bytes) {
+    size_t w = 0;
+    for (size_t c = 2; c <= kMaxWindow; ++c) {
+        if (table_bytes(bits, c) > budget) break;
+        w = c;
+    }
+    return w;
+}
+
+// 取 y 从第 pos 位开始的 w 位 (超出 n 个 Unit 的部分为 0)
+uint64_t get_bits(const mcl::Unit* y, size_t n, size_t pos, size_t w) {
+    const size_t unit_bits = sizeof(mcl::Unit) * 8;
+    uint64_t v = 0;
+    for (size_t b = 0; b < w; ++b) {
+        size_t q = (pos + b) / unit_bits;
+        if (q >= n) break;
+        v |= (uint64_t)((y[q] >> ((pos + b) % unit_bits)) & 1) << b;
+    }
+    return v;
+}
+
+}  // namespace
+
+FixedBaseTables::FixedBaseTables(const CRS& crs, size_t max_bytes) {
+    const size_t bits = Fr::getBitSize();
+    const size_t budget = max_bytes / 2;
+
+    g2_window = pick_window(bits, budget, g2_table_bytes);
+    if (g2_window) g2_table.init(crs.g2, bits, g2_window);
+
+    gt_window = pick_window(bits, budget, gt_table_bytes);
+    if (gt_window == 0) return;
+    gt_windows = gt_window_count(bits, gt_window);
+    const size_t half = size_t(1) << (gt_window - 1);
+    gt_table.resize(gt_windows * half);
+    // 第 i 个窗口: base_i = e_zn1^(2^(w*i))，存 base_i^1 .. base_i^half
+    GT base = crs.e_zn1;
+    for (size_t i = 0; i < gt_windows; ++i) {
+        GT* row = &gt_table[i * half];
+        row[0] = base;
+        for (size_t d = 1; d < half; ++d) GT::mul(row[d], row[d - 1], base);
+        // base_{i+1} = base_i^(2^w) = (base_i^half)^2
+        GT::sqr(base, row[half - 1]);
+    }
+}
+
+bool FixedBaseTables::mulG2(G2& out, const Fr& r) const {
+    if (g2_window == 0) return false;
+    g2_table.mul(out, r);
+    return true;
+}
+
+bool FixedBaseTables::powGT(GT& out, const Fr& r) const {
+    if (gt_window == 0) return false;
+    mcl::fp::Block b;
+    r.getBlock(b);
+
+    const size_t w = gt_window;
+    const int64_t full = int64_t(1) << w;
+    const int64_t half = full >> 1;
+    out.setOne();
+    int64_t carry = 0;
+    for (size_t i = 0; i < gt_windows; ++i) {
+        int64_t d = (int64_t)get_bits(b.p, b.n, i * w, w) + carry;
+        carry = 0;
+        if (d >= half) {
+            d -= full;
+            carry = 1;
+        }
+        if (d > 0) {
+            GT::mul(out, out, gt_table[i * half + d - 1]);
+        } else if (d < 0) {
+            GT inv;
+            GT::unitaryInv(inv, gt_table[i * half - d - 1]);
+            GT::mul(out, out, inv);
+        }
+    }
+    return true;
+}
+
+size_t FixedBaseTables::bytes() const {
+    const size_t bits = Fr::getBitSize();
+    return (g2_window ? g2_table_bytes(bits, g2_window) : 0) +
+           gt_table.size() * sizeof(GT);
+}
+
+void crs_enable_fixed_base(CRS& crs, size_t max_bytes) {
+    crs.fixed_base = std::make_shared<FixedBaseTables>(crs, max_bytes);
+}
+
+void crs_mul_g2(const CRS& crs, G2& out, const Fr& r) {
+    if (!crs.fixed_base || !crs.fixed_base->mulG2(out, r)) {
+        G2::mul(out, crs.g2, r);
+    }
+}
+
+void crs_pow_e_zn1(const CRS& crs, GT& out, const Fr& r) {
+    if (!crs.fixed_base || !crs.fixed_base->powGT(out, r)) {
+        GT::pow(out, crs.e_zn1, r);
+    }
+}
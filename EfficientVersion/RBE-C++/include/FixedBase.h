@@ -0,0 +1,47 @@
+#pragma once
+#include <RBE_Common.h>
+
+#include <mcl/window_method.hpp>
+
+#include <vector>
+
+// ---------------------------------------------------------
+// 固定底数的幂运算表。enc 的每个密文分量都要算 g2^r 和 e_zn1^r，
+// 底数是 CRS 里的常量，只有 r 每次不同：预先把底数按窗口展开成表，
+// 一次幂运算就只剩每个窗口一次查表加乘法，不再需要平方 / 倍点。
+//
+//   - g2: mcl 的 WindowMethod，每个 w 位窗口存 2^w 个 (归一化的) 点；
+//   - e_zn1: GT 在分圆子群里，求逆就是共轭 (unitaryInv，几乎不花时间)，
+//     所以指数改写成有符号的窗口数字 d in [-2^(w-1), 2^(w-1))，
+//     每个窗口只存 d = 1 .. 2^(w-1) 这一半，负的取共轭。
+//
+// 窗口越大表越大 (按 2^w 增长)，乘法次数按 1/w 减少；窗口大小由内存预算
+// 决定，两张表各占一半。表构造后不再改动，多个线程可以同时读。
+// ---------------------------------------------------------
+class FixedBaseTables {
+    size_t g2_window = 0;  // 0 表示预算不够，没有建表
+    mcl::fp::WindowMethod<G2> g2_table;
+
+    size_t gt_window = 0;
+    size_t gt_windows = 0;      // 窗口个数
+    std::vector<GT> gt_table;   // gt_windows * 2^(gt_window-1) 个
+
+   public:
+    // max_bytes: 两张表总共最多占用的内存
+    FixedBaseTables(const CRS& crs, size_t max_bytes);
+
+    // 预算不够、没有建表时返回 false，调用方自己算
+    bool mulG2(G2& out, const Fr& r) const;
+    bool powGT(GT& out, const Fr& r) const;
+
+    size_t g2Window() const { return g2_window; }
+    size_t gtWindow() const { return gt_window; }
+    size_t bytes() const;
+};
+
+// 给 CRS 开启固定底数表 (建表要几十到几百毫秒，setup / load_crs 之后调用一次)
+void crs_enable_fixed_base(CRS& crs, size_t max_bytes = 16 << 20);
+
+// out = g2^r / e_zn1^r，CRS 有表时查表，否则照常计算
+void crs_mul_g2(const CRS& crs, G2& out, const Fr& r);
+void crs_pow_e_zn1(const CRS& crs, GT& out, const Fr& r);
@@ -0,0 +1,349 @@
+#include <InMemoryStorage.h>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+// 快照文件头
+const char kSnapshotMagic[8] = {'R', 'B', 'E', 'M', 'E', 'M', '0', '2'};
+// 快照里点的编码：仿射坐标，恢复时不需要开方
+const int kSnapshotMode = mcl::IoEcAffineSerialize;
+
+G1 zero_g1() {
+    G1 zero;
+    zero.clear();
+    return zero;
+}
+
+// 辅助：读写定长整数
+void write_i64(std::ofstream& out, int64_t v) {
+    out.write((const char*)&v, sizeof(v));
+}
+bool read_i64(std::ifstream& in, int64_t& v) {
+    return (bool)in.read((char*)&v, sizeof(v));
+}
+
+// 辅助：读写一段点数组
+void write_points(std::ofstream& out, const G1* pts, size_t count) {
+    std::string buf(count * g1_bin_size(kSnapshotMode), '\0');
+    g1vec_serialize(&buf[0], pts, count, kSnapshotMode);
+    out.write(buf.data(), buf.size());
+}
+bool read_points(std::ifstream& in, G1* pts, size_t count) {
+    std::string buf(count * g1_bin_size(kSnapshotMode), '\0');
+    if (!in.read(&buf[0], buf.size())) return false;
+    g1vec_deserialize(pts, buf.data(), count, kSnapshotMode);
+    return true;
+}
+
+}  // namespace
+
+InMemoryStorage::InMemoryStorage(const CRS& crs)
+    : InMemoryStorage(crs.N, crs.n) {}
+
+InMemoryStorage::InMemoryStorage(int64_t N, int64_t n) : N(N), n(n) {
+    num_blocks = (N + n - 1) / n;
+    // 与 enc / upd 扫描的最大层数保持一致
+    num_levels = rbe_max_level(n) + 1;
+
+    const G1 zero = zero_g1();
+    user_blocks.resize(num_blocks);
+    pp_commitments.assign((size_t)num_blocks * num_levels, zero);
+    level_counts.assign((size_t)num_blocks * num_levels, 0);
+    aux_blocks.resize(num_blocks);
+    aux_present.assign((size_t)num_blocks * num_levels, 0);
+}
+
+G1* InMemoryStorage::auxRow(int64_t block_index, int level) {
+    std::vector<G1>& block = aux_blocks[block_index];
+    if (block.empty()) block.assign((size_t)num_levels * n, zero_g1());
+    return &block[(size_t)level * n];
+}
+
+InMemoryStorage::UserBlock& InMemoryStorage::userBlock(int64_t block_index) {
+    UserBlock& block = user_blocks[block_index];
+    if (block.registered.empty()) {
+        block.pks.assign(n, zero_g1());
+        block.registered.assign(n, 0);
+    }
+    return block;
+}
+
+// --- 用户 ---
+bool InMemoryStorage::isUserRegistered(int64_t id) {
+    if (id < 0 || id >= N) return false;
+    const UserBlock& block = user_blocks[id / n];
+    return !block.registered.empty() && block.registered[id % n];
+}
+
+void InMemoryStorage::saveUserPublicKey(int64_t id, const G1& pk) {
+    if (id < 0 || id >= N) {
+        std::cerr << "Error saving user pk: id " << id << " out of range"
+                  << std::endl;
+        return;
+    }
+    UserBlock& block = userBlock(id / n);
+    block.pks[id % n] = pk;
+    block.registered[id % n] = 1;
+}
+
+G1 InMemoryStorage::getUserPublicKey(int64_t id) {
+    G1 result;
+    result.clear();
+    if (isUserRegistered(id)) result = user_blocks[id / n].pks[id % n];
+    return result;
+}
+
+// --- PP ---
+G1 InMemoryStorage::getPPCommitment(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) return zero_g1();
+    return pp_commitments[slot(block_index, level)];
+}
+
+void InMemoryStorage::savePPCommitment(int64_t block_index, int level,
+                                       const G1& com) {
+    if (!inRange(block_index, level)) {
+        std::cerr << "Error saving commitment: block " << block_index
+                  << " level " << level << " out of range" << std::endl;
+        return;
+    }
+    pp_commitments[slot(block_index, level)] = com;
+}
+
+void InMemoryStorage::deletePPCommitment(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) return;
+    pp_commitments[slot(block_index, level)].clear();
+}
+
+// --- Aux 单行 ---
+G1 InMemoryStorage::getAuxUpdate(int64_t row_id, int level) {
+    int64_t block_index = row_id / n;
+    if (row_id < 0 || !inRange(block_index, level) ||
+        !aux_present[slot(block_index, level)]) {
+        return zero_g1();
+    }
+    return auxRow(block_index, level)[row_id % n];
+}
+
+void InMemoryStorage::saveAuxUpdate(int64_t row_id, int level, const G1& upd) {
+    int64_t block_index = row_id / n;
+    if (row_id < 0 || !inRange(block_index, level)) {
+        std::cerr << "Error saving aux update: row " << row_id << " level "
+                  << level << " out of range" << std::endl;
+        return;
+    }
+    G1* row = auxRow(block_index, level);
+    size_t s = slot(block_index, level);
+    if (!aux_present[s]) {
+        // 该层第一次写入：其余位置从 0 开始
+        for (int64_t i = 0; i < n; ++i) row[i].clear();
+        aux_present[s] = 1;
+    }
+    row[row_id % n] = upd;
+}
+
+void InMemoryStorage::deleteAuxUpdate(int64_t row_id, int level) {
+    int64_t block_index = row_id / n;
+    if (row_id < 0 || !inRange(block_index, level) ||
+        !aux_present[slot(block_index, level)]) {
+        return;
+    }
+    auxRow(block_index, level)[row_id % n].clear();
+}
+
+// --- Aux 整向量 ---
+std::vector<G1> InMemoryStorage::getAuxVector(int64_t block_index, int level) {
+    if (!inRange(block_index, level) ||
+        !aux_present[slot(block_index, level)]) {
+        return {};
+    }
+    const G1* row = auxRow(block_index, level);
+    return std::vector<G1>(row, row + n);
+}
+
+bool InMemoryStorage::readAuxVector(int64_t block_index, int level,
+                                    std::vector<G1>& out) {
+    if (!inRange(block_index, level) ||
+        !aux_present[slot(block_index, level)]) {
+        return false;
+    }
+    const G1* row = auxRow(block_index, level);
+    out.assign(row, row + n);
+    return true;
+}
+
+void InMemoryStorage::saveAuxVector(int64_t block_index, int level,
+                                    const std::vector<G1>& vec) {
+    if (!inRange(block_index, level) || (int64_t)vec.size() != n) {
+        std::cerr << "Error saving aux vector: block " << block_index
+                  << " level " << level << " size " << vec.size()
+                  << std::endl;
+        return;
+    }
+    std::copy(vec.begin(), vec.end(), auxRow(block_index, level));
+    aux_present[slot(block_index, level)] = 1;
+}
+
+void InMemoryStorage::deleteAuxVector(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) return;
+    // 只清标记；数据留在原处，下次写入时直接覆盖
+    aux_present[slot(block_index, level)] = 0;
+}
+
+// --- 计数器 ---
+int64_t InMemoryStorage::getUserCountInLevel(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) return 0;
+    return level_counts[slot(block_index, level)];
+}
+
+void InMemoryStorage::setUserCountInLevel(int64_t block_index, int level,
+                                          int64_t count) {
+    if (!inRange(block_index, level)) {
+        std::cerr << "Error saving count: block " << block_index << " level "
+                  << level << " out of range" << std::endl;
+        return;
+    }
+    level_counts[slot(block_index, level)] = count;
+}
+
+// 各层的计数在同一块内是连续存放的，直接从层占用还原，
+// 不单独保存 (也就不会和层数据不一致)。暂存层不属于二进制布局，不计入
+int64_t InMemoryStorage::getBlockUserCount(int64_t block_index) {
+    if (block_index < 0 || block_index >= num_blocks) return 0;
+    int64_t count = 0;
+    for (int lvl = 0; lvl < rbe_pending_level(n); ++lvl) {
+        if (level_counts[slot(block_index, lvl)] != 0) count |= (int64_t)1 << lvl;
+    }
+    return count;
+}
+
+void InMemoryStorage::setBlockUserCount(int64_t, int64_t) {}
+
+bool InMemoryStorage::hasAux(int64_t row_id, int level) {
+    int64_t block_index = row_id / n;
+    return row_id >= 0 && inRange(block_index, level) &&
+           aux_present[slot(block_index, level)];
+}
+
+// --- 快照 ---
+// 格式: magic | N n num_blocks num_levels | 按 id 排列的注册标记 (N 字节) |
+//       已注册用户的 pk | level_counts | pp_commitments | aux_present |
+//       每个 aux_present 为真的 (块, 层) 的 n 个点
+bool InMemoryStorage::saveSnapshot(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Can't open snapshot for writing: " << path << std::endl;
+        return false;
+    }
+    out.write(kSnapshotMagic, sizeof(kSnapshotMagic));
+    write_i64(out, N);
+    write_i64(out, n);
+    write_i64(out, num_blocks);
+    write_i64(out, num_levels);
+
+    // 没分配的块按全 0 写出，格式与按 id 排列的标记数组相同
+    std::vector<G1> pks;
+    const std::vector<uint8_t> none(n, 0);
+    for (int64_t k = 0; k < num_blocks; ++k) {
+        const UserBlock& block = user_blocks[k];
+        const int64_t m = usersInBlock(k);
+        if (block.registered.empty()) {
+            out.write((const char*)none.data(), m);
+            continue;
+        }
+        out.write((const char*)block.registered.data(), m);
+        for (int64_t i = 0; i < m; ++i) {
+            if (block.registered[i]) pks.push_back(block.pks[i]);
+        }
+    }
+    write_points(out, pks.data(), pks.size());
+
+    for (int64_t count : level_counts) write_i64(out, count);
+    write_points(out, pp_commitments.data(), pp_commitments.size());
+
+    out.write((const char*)aux_present.data(), aux_present.size());
+    for (int64_t k = 0; k < num_blocks; ++k) {
+        for (int lvl = 0; lvl < num_levels; ++lvl) {
+            if (!aux_present[slot(k, lvl)]) continue;
+            write_points(out, &aux_blocks[k][(size_t)lvl * n], n);
+        }
+    }
+    return (bool)out;
+}
+
+bool InMemoryStorage::loadSnapshot(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Can't open snapshot: " << path << std::endl;
+        return false;
+    }
+    char magic[sizeof(kSnapshotMagic)];
+    int64_t snap_N, snap_n, snap_blocks, snap_levels;
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kSnapshotMagic, sizeof(magic)) != 0 ||
+        !read_i64(in, snap_N) || !read_i64(in, snap_n) ||
+        !read_i64(in, snap_blocks) || !read_i64(in, snap_levels)) {
+        std::cerr << "Bad snapshot header: " << path << std::endl;
+        return false;
+    }
+    if (snap_N != N || snap_n != n || snap_blocks != num_blocks ||
+        snap_levels != num_levels) {
+        std::cerr << "Snapshot dimensions do not match CRS: " << path
+                  << std::endl;
+        return false;
+    }
+
+    // 先读进临时对象，全部成功后再替换，避免读到一半留下混合状态
+    InMemoryStorage tmp(N, n);
+    std::vector<uint8_t> flags(n);
+    size_t registered = 0;
+    for (int64_t k = 0; k < num_blocks && in; ++k) {
+        const int64_t m = tmp.usersInBlock(k);
+        if (!in.read((char*)flags.data(), m)) break;
+        size_t count = 0;
+        for (int64_t i = 0; i < m; ++i) count += (flags[i] != 0);
+        if (count == 0) continue;
+        std::copy(flags.begin(), flags.begin() + m,
+                  tmp.userBlock(k).registered.begin());
+        registered += count;
+    }
+    std::vector<G1> pks(registered);
+    if (!in || !read_points(in, pks.data(), pks.size())) {
+        std::cerr << "Truncated snapshot: " << path << std::endl;
+        return false;
+    }
+    size_t j = 0;
+    for (UserBlock& block : tmp.user_blocks) {
+        for (size_t i = 0; i < block.registered.size(); ++i) {
+            if (block.registered[i]) block.pks[i] = pks[j++];
+        }
+    }
+
+    for (int64_t& count : tmp.level_counts) {
+        if (!read_i64(in, count)) {
+            std::cerr << "Truncated snapshot: " << path << std::endl;
+            return false;
+        }
+    }
+    if (!read_points(in, tmp.pp_commitments.data(),
+                     tmp.pp_commitments.size()) ||
+        !in.read((char*)tmp.aux_present.data(), tmp.aux_present.size())) {
+        std::cerr << "Truncated snapshot: " << path << std::endl;
+        return false;
+    }
+    for (auto& block : tmp.aux_blocks) block.clear();
+    for (int64_t k = 0; k < num_blocks; ++k) {
+        for (int lvl = 0; lvl < num_levels; ++lvl) {
+            if (!tmp.aux_present[tmp.slot(k, lvl)]) continue;
+            if (!read_points(in, tmp.auxRow(k, lvl), n)) {
+                std::cerr << "Truncated snapshot: " << path << std::endl;
+                return false;
+            }
+        }
+    }
+
+    *this = std::move(tmp);
+    return true;
+}
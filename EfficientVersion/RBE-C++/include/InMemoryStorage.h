@@ -1,48 +1,105 @@
-// #pragma once
-// #include <Storage.h>
-
-// #include <map>
-
-// // ---------------------------------------------------------
-// // 为了让你快速跑通算法逻辑，我们先写一个 "内存版" 的实现。
-// // 等算法调通了，我们再写一个 "SQLite版" 的实现替换它。
-// // 这样可以避免 SQL 语法错误干扰我们调试数学逻辑。
-// // ---------------------------------------------------------
-// class InMemoryStorage : public Storage {
-//     std::map<int, G1> user_pks;
-//     std::map<int, G1> pp_commitments;
-//     std::map<int, G1> aux_updates;
-
-//    public:
-//     bool isUserRegistered(int id) override { return user_pks.count(id); }
-
-//     void saveUserPublicKey(int id, const G1& pk) override { user_pks[id] =
-//     pk; }
-
-//     G1 getPPCommitment(int block_index) override {
-//         if (pp_commitments.count(block_index)) {
-//             return pp_commitments[block_index];
-//         }
-//         // 如果不存在，返回 0 (单位元)
-//         G1 zero;
-//         zero.clear();  // mcl 中 clear() 设置为无穷远点(加法单位元)
-//         return zero;
-//     }
-
-//     void savePPCommitment(int block_index, const G1& new_com) override {
-//         pp_commitments[block_index] = new_com;
-//     }
-
-//     G1 getAuxUpdate(int row_id) override {
-//         if (aux_updates.count(row_id)) {
-//             return aux_updates[row_id];
-//         }
-//         G1 zero;
-//         zero.clear();
-//         return zero;
-//     }
-
-//     void saveAuxUpdate(int row_id, const G1& upd) override {
-//         aux_updates[row_id] = upd;
-//     }
-// };
\ No newline at end of file
+#pragma once
+#include <Storage.h>
+#include <my_utils.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------
+// "内存版" 的实现。
+// 所有状态都放在按 (块, 层, 位置) 下标寻址的连续数组里，而不是 std::map：
+//   - 适合把状态常驻内存、定期做快照 (saveSnapshot / loadSnapshot) 的部署；
+//   - 也是零 I/O 的基线，用来把密码学开销和存储开销分开测量。
+// 数组在构造时按最大规模分配好 (每块的公钥和 Aux 只在该块自己第一次写入时
+// 分配，N 很大时不会按用户数预先分配点)，
+// 之后只按下标读写，所以不同块上的调用可以并发；快照期间不能有写入。
+// 维度由 CRS 决定：N 个用户、N/n 个块、每块 n 个位置、
+// 层数与 enc/upd 扫描的范围一致 (0 .. ceil(log2 n) + 2)。
+// ---------------------------------------------------------
+class InMemoryStorage : public Storage {
+    int64_t N;           // 用户数
+    int64_t n;           // 块大小
+    int64_t num_blocks;  // 块数 = ceil(N / n)
+    int num_levels;      // 每块的层数
+
+    // 用户公钥与注册标记：每块一段，下标为块内位置 id % n。
+    // 该块第一次有人注册时才分配，没人注册的块不占空间
+    struct UserBlock {
+        std::vector<G1> pks;
+        std::vector<uint8_t> registered;
+    };
+    std::vector<UserBlock> user_blocks;
+
+    // 承诺与计数，下标为 block * num_levels + level
+    std::vector<G1> pp_commitments;
+    std::vector<int64_t> level_counts;
+
+    // Aux：每块一段连续内存 [level][position]，共 num_levels * n 个点。
+    // 第一次写入该块时才分配，没人注册的块不占空间
+    std::vector<std::vector<G1>> aux_blocks;
+    // 某块某层是否存有 Aux 向量，下标同 pp_commitments
+    std::vector<uint8_t> aux_present;
+
+    // 辅助：(块, 层) 是否在范围内，以及它在扁平数组里的下标
+    bool inRange(int64_t block_index, int level) const {
+        return block_index >= 0 && block_index < num_blocks && level >= 0 &&
+               level < num_levels;
+    }
+    size_t slot(int64_t block_index, int level) const {
+        return (size_t)block_index * num_levels + level;
+    }
+    // 辅助：取某块某层 Aux 的首地址 (必要时分配该块)
+    G1* auxRow(int64_t block_index, int level);
+    // 辅助：取某块的用户段 (必要时分配)
+    UserBlock& userBlock(int64_t block_index);
+    // 辅助：块 k 里的用户数 (最后一块可能不满 n)
+    int64_t usersInBlock(int64_t block_index) const {
+        return std::min(n, N - block_index * n);
+    }
+
+    // 辅助：按维度构造 (快照恢复时用来建临时对象)
+    InMemoryStorage(int64_t N, int64_t n);
+
+   public:
+    explicit InMemoryStorage(const CRS& crs);
+
+    bool isUserRegistered(int64_t id) override;
+    void saveUserPublicKey(int64_t id, const G1& pk) override;
+    G1 getUserPublicKey(int64_t id) override;
+
+    G1 getPPCommitment(int64_t block_index, int level) override;
+    void savePPCommitment(int64_t block_index, int level,
+                          const G1& com) override;
+    void deletePPCommitment(int64_t block_index, int level) override;
+
+    G1 getAuxUpdate(int64_t row_id, int level) override;
+    void saveAuxUpdate(int64_t row_id, int level, const G1& upd) override;
+    void deleteAuxUpdate(int64_t row_id, int level) override;
+
+    std::vector<G1> getAuxVector(int64_t block_index, int level) override;
+    void saveAuxVector(int64_t block_index, int level,
+                       const std::vector<G1>& vec) override;
+    void deleteAuxVector(int64_t block_index, int level) override;
+    bool readAuxVector(int64_t block_index, int level,
+                       std::vector<G1>& out) override;
+
+    int64_t getUserCountInLevel(int64_t block_index, int level) override;
+    void setUserCountInLevel(int64_t block_index, int level,
+                             int64_t count) override;
+
+    int64_t getBlockUserCount(int64_t block_index) override;
+    void setBlockUserCount(int64_t block_index, int64_t count) override;
+
+    bool hasAux(int64_t row_id, int level) override;
+
+    // 每块的状态在各自的槽位里，不同块的读写互不相干
+    bool isConcurrencySafe() const override { return true; }
+
+    // --- 快照 ---
+    // 把全部状态写入一个二进制文件 / 从文件恢复 (维度必须与当前 CRS 一致)。
+    // 点用未压缩仿射编码，恢复时不需要开方。成功返回 true。
+    bool saveSnapshot(const std::string& path) const;
+    bool loadSnapshot(const std::string& path);
+};
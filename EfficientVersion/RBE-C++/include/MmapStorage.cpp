@@ -0,0 +1,299 @@
+#include <MmapStorage.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const char kMmapMagic[8] = {'R', 'B', 'E', 'M', 'M', 'A', 'P', '1'};
+// 版本 2：维度与计数改为 64 位
+// 版本 3：每块多出延迟合并的暂存层 (kRbePendingGroups)
+const uint32_t kMmapVersion = 3;
+const size_t kPageSize = 4096;
+
+// 文件头，放在第一页
+struct MmapHeader {
+    char magic[8];
+    uint32_t version;
+    int64_t N;
+    int64_t n;
+    int64_t num_blocks;
+    int32_t num_levels;
+    int32_t ser_mode;
+    uint32_t point_size;
+};
+
+size_t page_align(size_t x) {
+    return (x + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+}  // namespace
+
+void MmapStorage::computeLayout() {
+    const size_t slots = (size_t)num_blocks * num_levels;
+    off_user_flags = kPageSize;  // 第一页是文件头
+    off_user_pks = page_align(off_user_flags + (size_t)N);
+    off_counts = page_align(off_user_pks + (size_t)N * point_size);
+    off_aux_present = page_align(off_counts + slots * sizeof(int64_t));
+    off_pp = page_align(off_aux_present + slots);
+    off_aux = page_align(off_pp + slots * point_size);
+    file_size = page_align(off_aux + slots * n * point_size);
+}
+
+MmapStorage::MmapStorage(const std::string& path, const CRS& crs,
+                         int ser_mode)
+    : N(crs.N), n(crs.n), ser_mode(ser_mode) {
+    num_blocks = (N + n - 1) / n;
+    // 与 enc / upd 扫描的最大层数保持一致
+    num_levels = rbe_max_level(n) + 1;
+
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Can't open mmap file: " << path << " ("
+                  << std::strerror(errno) << ")" << std::endl;
+        exit(1);
+    }
+    struct stat st;
+    fstat(fd, &st);
+
+    MmapHeader header;
+    if (st.st_size >= (off_t)sizeof(header)) {
+        // 已有文件：校验文件头，点编码以文件为准
+        ssize_t got = pread(fd, &header, sizeof(header), 0);
+        if (got != (ssize_t)sizeof(header) ||
+            std::memcmp(header.magic, kMmapMagic, sizeof(kMmapMagic)) != 0 ||
+            header.version != kMmapVersion) {
+            std::cerr << "Bad mmap file header: " << path << std::endl;
+            exit(1);
+        }
+        if (header.N != N || header.n != n ||
+            header.num_blocks != num_blocks ||
+            header.num_levels != num_levels) {
+            std::cerr << "Mmap file dimensions do not match CRS: " << path
+                      << std::endl;
+            exit(1);
+        }
+        this->ser_mode = header.ser_mode;
+        point_size = header.point_size;
+        computeLayout();
+    } else {
+        // 新文件 (或上次连文件头都没写完的文件)：先写文件头并落盘，再扩成
+        // 稀疏文件。中途崩溃时文件要么短于文件头 (下次重新初始化)，要么只有
+        // 文件头 (下次接着扩)，不会出现全尺寸、文件头却是 0 的文件
+        point_size = g1_bin_size(ser_mode);
+        computeLayout();
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMmapMagic, sizeof(kMmapMagic));
+        header.version = kMmapVersion;
+        header.N = N;
+        header.n = n;
+        header.num_blocks = num_blocks;
+        header.num_levels = num_levels;
+        header.ser_mode = ser_mode;
+        header.point_size = point_size;
+        ssize_t put = pwrite(fd, &header, sizeof(header), 0);
+        if (put != (ssize_t)sizeof(header) || fsync(fd) != 0) {
+            std::cerr << "Can't write mmap file header: " << path << " ("
+                      << std::strerror(errno) << ")" << std::endl;
+            exit(1);
+        }
+        st.st_size = sizeof(header);
+    }
+    size_t old_size = st.st_size;
+    if (old_size > sizeof(header) && old_size < file_size) {
+        std::cerr << "Truncated mmap file: " << path << std::endl;
+        exit(1);
+    }
+    if (old_size < file_size) {
+        // 只有文件头：按最大规模扩成稀疏文件
+        if (ftruncate(fd, file_size) != 0 || fsync(fd) != 0) {
+            std::cerr << "Can't size mmap file: " << path << " ("
+                      << std::strerror(errno) << ")" << std::endl;
+            exit(1);
+        }
+    }
+
+    void* addr =
+        mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        std::cerr << "Can't mmap file: " << path << " ("
+                  << std::strerror(errno) << ")" << std::endl;
+        exit(1);
+    }
+    base = (uint8_t*)addr;
+}
+
+MmapStorage::~MmapStorage() {
+    if (base) {
+        msync(base, file_size, MS_SYNC);
+        munmap(base, file_size);
+    }
+    if (fd >= 0) close(fd);
+}
+
+void MmapStorage::checkpoint() {
+    if (msync(base, file_size, MS_SYNC) != 0) {
+        std::cerr << "msync failed: " << std::strerror(errno) << std::endl;
+    }
+}
+
+// --- 用户 ---
+bool MmapStorage::isUserRegistered(int64_t id) {
+    return id >= 0 && id < N && base[off_user_flags + id];
+}
+
+void MmapStorage::saveUserPublicKey(int64_t id, const G1& pk) {
+    if (id < 0 || id >= N) {
+        std::cerr << "Error saving user pk: id " << id << " out of range"
+                  << std::endl;
+        return;
+    }
+    writePoint(userPkAt(id), pk);
+    base[off_user_flags + id] = 1;
+}
+
+G1 MmapStorage::getUserPublicKey(int64_t id) {
+    G1 result;
+    result.clear();
+    if (isUserRegistered(id)) result = readPoint(userPkAt(id));
+    return result;
+}
+
+// --- PP ---
+G1 MmapStorage::getPPCommitment(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) {
+        G1 zero;
+        zero.clear();
+        return zero;
+    }
+    return readPoint(ppAt(block_index, level));
+}
+
+void MmapStorage::savePPCommitment(int64_t block_index, int level,
+                                   const G1& com) {
+    if (!inRange(block_index, level)) {
+        std::cerr << "Error saving commitment: block " << block_index
+                  << " level " << level << " out of range" << std::endl;
+        return;
+    }
+    writePoint(ppAt(block_index, level), com);
+}
+
+void MmapStorage::deletePPCommitment(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) return;
+    std::memset(ppAt(block_index, level), 0, point_size);
+}
+
+// --- Aux 单行 ---
+G1 MmapStorage::getAuxUpdate(int64_t row_id, int level) {
+    int64_t block_index = row_id / n;
+    if (row_id < 0 || !inRange(block_index, level) ||
+        !*auxPresentAt(block_index, level)) {
+        G1 zero;
+        zero.clear();
+        return zero;
+    }
+    return readPoint(auxAt(block_index, level, row_id % n));
+}
+
+void MmapStorage::saveAuxUpdate(int64_t row_id, int level, const G1& upd) {
+    int64_t block_index = row_id / n;
+    if (row_id < 0 || !inRange(block_index, level)) {
+        std::cerr << "Error saving aux update: row " << row_id << " level "
+                  << level << " out of range" << std::endl;
+        return;
+    }
+    uint8_t* present = auxPresentAt(block_index, level);
+    if (!*present) {
+        // 该层第一次写入：其余位置从 0 开始
+        std::memset(auxAt(block_index, level, 0), 0, n * point_size);
+        *present = 1;
+    }
+    writePoint(auxAt(block_index, level, row_id % n), upd);
+}
+
+void MmapStorage::deleteAuxUpdate(int64_t row_id, int level) {
+    int64_t block_index = row_id / n;
+    if (row_id < 0 || !inRange(block_index, level) ||
+        !*auxPresentAt(block_index, level)) {
+        return;
+    }
+    std::memset(auxAt(block_index, level, row_id % n), 0, point_size);
+}
+
+// --- Aux 整向量 ---
+std::vector<G1> MmapStorage::getAuxVector(int64_t block_index, int level) {
+    std::vector<G1> vec;
+    readAuxVector(block_index, level, vec);
+    return vec;
+}
+
+bool MmapStorage::readAuxVector(int64_t block_index, int level,
+                                std::vector<G1>& out) {
+    if (!inRange(block_index, level) || !*auxPresentAt(block_index, level)) {
+        return false;
+    }
+    out.resize(n);
+    g1vec_deserialize(out.data(), (const char*)auxAt(block_index, level, 0),
+                      n, ser_mode);
+    return true;
+}
+
+void MmapStorage::saveAuxVector(int64_t block_index, int level,
+                                const std::vector<G1>& vec) {
+    if (!inRange(block_index, level) || (int64_t)vec.size() != n) {
+        std::cerr << "Error saving aux vector: block " << block_index
+                  << " level " << level << " size " << vec.size()
+                  << std::endl;
+        return;
+    }
+    g1vec_serialize((char*)auxAt(block_index, level, 0), vec.data(), n,
+                    ser_mode);
+    *auxPresentAt(block_index, level) = 1;
+}
+
+void MmapStorage::deleteAuxVector(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) return;
+    // 只清标记；旧数据留在槽位里，下次写入时直接覆盖
+    *auxPresentAt(block_index, level) = 0;
+}
+
+// --- 计数器 ---
+int64_t MmapStorage::getUserCountInLevel(int64_t block_index, int level) {
+    if (!inRange(block_index, level)) return 0;
+    return *countAt(block_index, level);
+}
+
+void MmapStorage::setUserCountInLevel(int64_t block_index, int level,
+                                      int64_t count) {
+    if (!inRange(block_index, level)) {
+        std::cerr << "Error saving count: block " << block_index << " level "
+                  << level << " out of range" << std::endl;
+        return;
+    }
+    *countAt(block_index, level) = count;
+}
+
+// 各层的计数在同一块内是连续存放的，直接从层占用还原，
+// 不单独保存 (也就不会和层数据不一致)。暂存层不属于二进制布局，不计入
+int64_t MmapStorage::getBlockUserCount(int64_t block_index) {
+    if (block_index < 0 || block_index >= num_blocks) return 0;
+    int64_t count = 0;
+    for (int lvl = 0; lvl < rbe_pending_level(n); ++lvl) {
+        if (*countAt(block_index, lvl) != 0) count |= (int64_t)1 << lvl;
+    }
+    return count;
+}
+
+void MmapStorage::setBlockUserCount(int64_t, int64_t) {}
+
+bool MmapStorage::hasAux(int64_t row_id, int level) {
+    int64_t block_index = row_id / n;
+    return row_id >= 0 && inRange(block_index, level) &&
+           *auxPresentAt(block_index, level);
+}
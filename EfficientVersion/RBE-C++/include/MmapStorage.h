@@ -0,0 +1,125 @@
+#pragma once
+#include <Storage.h>
+#include <my_utils.h>
+
+#include <cstdint>
+#include <string>
+
+// ---------------------------------------------------------
+// "内存映射文件版" 的实现。
+// 曲线点序列化后是定长的，所以整个状态可以排成一个稠密的定长槽位数组，
+// 直接映射进地址空间：读就是指针运算 + 解码，写直接落进页缓存，
+// 没有 SQL 层。文件按最大规模一次性 ftruncate 成稀疏文件，未写过的页
+// 不占磁盘，也不占内存；全零字节恰好就是零元 (无穷远点) 的编码。
+// 重启时只需重新 mmap，不需要加载。
+//
+// 文件布局 (各区域按页对齐)：
+//   header      魔数、版本、维度、点编码
+//   user_flags  [N]                       是否已注册
+//   user_pks    [N][point]
+//   counts      [blocks][levels] int64
+//   aux_present [blocks][levels] uint8     该层是否存有 Aux 向量
+//   pp          [blocks][levels][point]
+//   aux         [blocks][levels][n][point] 同一 (块, 层) 的 n 个点连续存放
+//
+// 持久性：写入只保证进了页缓存，调用 checkpoint() (msync) 才保证落盘。
+// ---------------------------------------------------------
+class MmapStorage : public Storage {
+    int fd = -1;
+    uint8_t* base = nullptr;  // 映射首地址
+    size_t file_size = 0;
+
+    int64_t N;
+    int64_t n;
+    int64_t num_blocks;
+    int num_levels;
+    int ser_mode;
+    size_t point_size;
+
+    // 各区域在文件中的偏移
+    size_t off_user_flags, off_user_pks, off_counts, off_aux_present, off_pp,
+        off_aux;
+
+    bool inRange(int64_t block_index, int level) const {
+        return block_index >= 0 && block_index < num_blocks && level >= 0 &&
+               level < num_levels;
+    }
+    size_t slot(int64_t block_index, int level) const {
+        return (size_t)block_index * num_levels + level;
+    }
+
+    // 辅助：各类槽位的地址
+    uint8_t* userPkAt(int64_t id) {
+        return base + off_user_pks + id * point_size;
+    }
+    int64_t* countAt(int64_t block_index, int level) {
+        return (int64_t*)(base + off_counts) + slot(block_index, level);
+    }
+    uint8_t* auxPresentAt(int64_t block_index, int level) {
+        return base + off_aux_present + slot(block_index, level);
+    }
+    uint8_t* ppAt(int64_t block_index, int level) {
+        return base + off_pp + slot(block_index, level) * point_size;
+    }
+    uint8_t* auxAt(int64_t block_index, int level, int64_t pos) {
+        return base + off_aux +
+               (slot(block_index, level) * n + pos) * point_size;
+    }
+
+    // 辅助：按维度计算布局 (各区域偏移与文件总大小)
+    void computeLayout();
+
+    // 辅助：单点读写
+    G1 readPoint(const uint8_t* p) const {
+        return stored_bin_to_g1((const char*)p, point_size, ser_mode);
+    }
+    void writePoint(uint8_t* p, const G1& pt) const {
+        g1vec_serialize((char*)p, &pt, 1, ser_mode);
+    }
+
+   public:
+    // 打开或创建映射文件。已存在的文件维度必须与 CRS 一致，
+    // 点编码以文件里记录的为准。ser_mode 见 my_utils.h，默认用仿射编码，
+    // 读取时不需要开方。
+    MmapStorage(const std::string& path, const CRS& crs,
+                int ser_mode = mcl::IoEcAffineSerialize);
+    ~MmapStorage();
+
+    MmapStorage(const MmapStorage&) = delete;
+    MmapStorage& operator=(const MmapStorage&) = delete;
+
+    bool isUserRegistered(int64_t id) override;
+    void saveUserPublicKey(int64_t id, const G1& pk) override;
+    G1 getUserPublicKey(int64_t id) override;
+
+    G1 getPPCommitment(int64_t block_index, int level) override;
+    void savePPCommitment(int64_t block_index, int level,
+                          const G1& com) override;
+    void deletePPCommitment(int64_t block_index, int level) override;
+
+    G1 getAuxUpdate(int64_t row_id, int level) override;
+    void saveAuxUpdate(int64_t row_id, int level, const G1& upd) override;
+    void deleteAuxUpdate(int64_t row_id, int level) override;
+
+    std::vector<G1> getAuxVector(int64_t block_index, int level) override;
+    void saveAuxVector(int64_t block_index, int level,
+                       const std::vector<G1>& vec) override;
+    void deleteAuxVector(int64_t block_index, int level) override;
+    bool readAuxVector(int64_t block_index, int level,
+                       std::vector<G1>& out) override;
+
+    int64_t getUserCountInLevel(int64_t block_index, int level) override;
+    void setUserCountInLevel(int64_t block_index, int level,
+                             int64_t count) override;
+
+    int64_t getBlockUserCount(int64_t block_index) override;
+    void setBlockUserCount(int64_t block_index, int64_t count) override;
+
+    bool hasAux(int64_t row_id, int level) override;
+
+    // 不同块落在映射里互不重叠的字节上，可以并发读写
+    bool isConcurrencySafe() const override { return true; }
+
+    // 把页缓存里的修改同步到磁盘 (msync MS_SYNC)
+    void checkpoint();
+};
@@ -0,0 +1,76 @@
+#include <PairingTables.h>
+
+PairingTables::PairingTables(const CRS& crs, size_t max_bytes)
+    : table_size(getPrecomputedQcoeffSize()),
+      h_coeff(new std::atomic<const Fp6*>[crs.h_g2.size()]),
+      h_count(crs.h_g2.size()) {
+    precomputeG2(g2_coeff, crs.g2);
+    const size_t table_bytes = table_size * sizeof(Fp6);
+    max_tables = max_bytes > table_bytes ? max_bytes / table_bytes - 1 : 0;
+    for (size_t j = 0; j < h_count; ++j) h_coeff[j].store(nullptr);
+}
+
+const Fp6* PairingTables::forH(const CRS& crs, int64_t j) {
+    if (j <= 0 || (size_t)j >= h_count || j == crs.n + 1) return nullptr;
+    const Fp6* table = h_coeff[j].load(std::memory_order_acquire);
+    if (table) return table;
+
+    std::lock_guard<std::mutex> guard(build_mutex);
+    table = h_coeff[j].load(std::memory_order_relaxed);
+    if (table || owned.size() >= max_tables) return table;
+    Fp6* built = new Fp6[table_size];
+    precomputeG2(built, crs.h_g2[j]);
+    owned.emplace_back(built);
+    h_coeff[j].store(built, std::memory_order_release);
+    return built;
+}
+
+void PairingTables::buildAll(const CRS& crs) {
+    for (int64_t j = 1; j <= crs.n; ++j) {
+        if (!forH(crs, j)) break;
+    }
+}
+
+size_t PairingTables::tablesBuilt() {
+    std::lock_guard<std::mutex> guard(build_mutex);
+    return owned.size();
+}
+
+void crs_enable_precompute(CRS& crs, size_t max_bytes, bool eager) {
+    crs.tables = std::make_shared<PairingTables>(crs, max_bytes);
+    if (eager) crs.tables->buildAll(crs);
+}
+
+void crs_miller_loop_g2(const CRS& crs, Fp12& f, const G1& P) {
+    if (crs.tables) {
+        precomputedMillerLoop(f, P, crs.tables->forG2());
+    } else {
+        millerLoop(f, P, crs.g2);
+    }
+}
+
+void crs_miller_loop_h(const CRS& crs, Fp12& f, const G1& P, int64_t j) {
+    const Fp6* table = crs.tables ? crs.tables->forH(crs, j) : nullptr;
+    if (table) {
+        precomputedMillerLoop(f, P, table);
+    } else {
+        millerLoop(f, P, crs.h_g2[j]);
+    }
+}
+
+void crs_miller_loop_h_g2(const CRS& crs, Fp12& f, const G1& P1, int64_t j,
+                          const G1& P2) {
+    if (!crs.tables) {
+        const G1 P[2] = {P1, P2};
+        const G2 Q[2] = {crs.h_g2[j], crs.g2};
+        millerLoopVec(f, P, Q, 2);
+        return;
+    }
+    const Fp6* table = crs.tables->forH(crs, j);
+    if (table) {
+        precomputedMillerLoop2(f, P1, table, P2, crs.tables->forG2());
+    } else {
+        precomputedMillerLoop2mixed(f, P1, crs.h_g2[j], P2,
+                                    crs.tables->forG2());
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <RBE_Common.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// ---------------------------------------------------------
+// CRS 里 G2 点的 Miller loop 系数表 (mcl::bn::precomputeG2)。
+// enc / dec / 辅助值校验里配对的 G2 一侧几乎都是固定的 g2 或 h_g2[j]，
+// 每次完整的 Miller loop 都要重新算一遍直线函数；预先算好系数后，
+// precomputedMillerLoop 只剩 G1 一侧的求值。
+//
+// 每张表约 getPrecomputedQcoeffSize() 个 Fp6 (BLS12-381 上约 20 KB)，
+// n 个 h_g2 全部预计算会很大，所以总内存有上限：g2 的表总是有，
+// h_g2 按第一次用到的先后 (或 eager 时按下标) 构造，预算用完后其余的
+// 照常走完整的 Miller loop。表一旦构造就不再改动，多个线程可以同时读。
+// ---------------------------------------------------------
+class PairingTables {
+    size_t table_size;  // 每张表的 Fp6 个数
+    size_t max_tables;  // h_g2 的表最多构造几张
+    std::vector<Fp6> g2_coeff;
+
+    // h_coeff[j] 指向 h_g2[j] 的系数表，还没构造时为空
+    std::unique_ptr<std::atomic<const Fp6*>[]> h_coeff;
+    size_t h_count;
+
+    std::mutex build_mutex;
+    std::vector<std::unique_ptr<Fp6[]>> owned;  // 已构造的表
+
+   public:
+    // max_bytes: 系数表总共最多占用的内存 (至少会有 g2 的一张)
+    PairingTables(const CRS& crs, size_t max_bytes);
+
+    PairingTables(const PairingTables&) = delete;
+    PairingTables& operator=(const PairingTables&) = delete;
+
+    const Fp6* forG2() const { return g2_coeff.data(); }
+    // h_g2[j] 的表，需要时构造；超出预算时返回 nullptr
+    const Fp6* forH(const CRS& crs, int64_t j);
+    // 在预算内构造 h_g2[1..n] 的表 (enc / dec 用到的就是这些)
+    void buildAll(const CRS& crs);
+    size_t tablesBuilt();
+};
+
+// 给 CRS 开启系数表。max_bytes 是内存上限；eager 为 true 时立即构造
+// 预算内的全部表，否则第一次用到某个 h_g2[j] 时再构造
+void crs_enable_precompute(CRS& crs, size_t max_bytes = 64 << 20,
+                           bool eager = false);
+
+// 以下是配对的 Miller loop 部分 (之后还要 finalExp)，CRS 有系数表时用
+// 预计算的版本，否则退回完整的 millerLoop
+// f = ML(P, g2)
+void crs_miller_loop_g2(const CRS& crs, Fp12& f, const G1& P);
+// f = ML(P, h_g2[j])
+void crs_miller_loop_h(const CRS& crs, Fp12& f, const G1& P, int64_t j);
+// f = ML(P1, h_g2[j]) * ML(P2, g2)，两个都有表时共用一次 Miller loop
+void crs_miller_loop_h_g2(const CRS& crs, Fp12& f, const G1& P1, int64_t j,
+                          const G1& P2);
@@ -0,0 +1,107 @@
+#include <PointDecoder.h>
+#include <my_utils.h>
+
+#include <cstring>
+
+namespace {
+
+// 每段的点数：段太小时领取和同步的开销盖过解码本身
+const size_t kChunk = 64;
+
+}  // namespace
+
+PointDecoder::PointDecoder(int num_threads) {
+    for (int t = 1; t < num_threads; ++t) {
+        workers.emplace_back(&PointDecoder::workerLoop, this);
+    }
+}
+
+PointDecoder::~PointDecoder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (std::thread& t : workers) t.join();
+}
+
+void PointDecoder::drain() {
+    size_t done = 0;
+    int64_t bad = -1;
+    for (size_t c = next++; c < num_chunks; c = next++) {
+        size_t begin = c * kChunk;
+        size_t m = std::min(kChunk, count - begin);
+        int64_t i = g1vec_decode(out + begin, data + begin * g1_bin_size(mode),
+                                 m, mode);
+        if (i >= 0 && bad < 0) bad = begin + i;
+        done++;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bad >= 0 && (first_bad < 0 || bad < first_bad)) first_bad = bad;
+    chunks_done += done;
+}
+
+void PointDecoder::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_cv.wait(lock,
+                         [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            active++;
+        }
+        drain();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            active--;
+        }
+        done_cv.notify_all();
+    }
+}
+
+int64_t PointDecoder::decode(G1* out_, const char* data_, size_t n,
+                             int mode_) {
+    // 点数不够分段，或者没有工作线程，就地解码
+    if (workers.empty() || n <= kChunk) {
+        return g1vec_decode(out_, data_, n, mode_);
+    }
+
+    std::lock_guard<std::mutex> call(call_mutex);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // 上一轮结束后才醒来的工作线程可能还在 drain 里 (领不到段)，
+        // 等它们退出再改任务
+        done_cv.wait(lock, [this] { return active == 0; });
+        out = out_;
+        data = data_;
+        count = n;
+        mode = mode_;
+        num_chunks = (n + kChunk - 1) / kChunk;
+        chunks_done = 0;
+        first_bad = -1;
+        next = 0;
+        generation++;
+    }
+    work_cv.notify_all();
+    drain();  // 调用线程也干活
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // 还要等进入本轮的工作线程都退出 drain，它们才不会领到下一轮的段
+    done_cv.wait(lock, [this] {
+        return chunks_done == num_chunks && active == 0;
+    });
+    return first_bad;
+}
+
+bool PointDecoder::decodeRequest(const char* data_, size_t bytes, int64_t n,
+                                 int mode_, RegRequest& r) {
+    const size_t point_size = g1_bin_size(mode_);
+    if (bytes != sizeof(int64_t) + (1 + n) * point_size) return false;
+    std::memcpy(&r.id, data_, sizeof(int64_t));
+    const char* points = data_ + sizeof(int64_t);
+    if (g1vec_decode(&r.pk, points, 1, mode_) >= 0) return false;
+    r.xi.resize(n);
+    return decode(r.xi.data(), points + point_size, n, mode_) < 0;
+}
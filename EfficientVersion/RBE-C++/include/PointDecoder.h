@@ -0,0 +1,70 @@
+#pragma once
+#include <RBE_Common.h>
+#include <algos.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---------------------------------------------------------
+// 并行解码注册请求里的点。
+// 每次注册带 n 个辅助值 xi，从线上格式还原时每个点要开一次平方根 (压缩模式)
+// 再做一次子群检查，这是 curator 处理每个 reg 的第一步，也是最贵的一步。
+// 这里把一个向量切成若干段，交给常驻的工作线程各自用 g1vec_decode 解码
+// (调用线程也参与)，点直接从输入缓冲解码到输出向量，不逐点分配。
+//
+// 子群检查仍然逐点做，只是分摊到各个线程：随机线性组合式的批量检查
+// (检查 sum r_i * P_i) 在 BLS12-381 的 G1 上不可靠，余因子含有 3 这样的
+// 小素因子，不在子群里的点有约 1/3 的概率在组合里被抵消掉。
+//
+// 这是不可信数据进入 curator 的唯一入口：线上收到的注册请求交给
+// ConcurrentRegistrar::regWire，由它用 decodeRequest 解码校验一次，之后写进
+// 日志 / 存储的点都按可信数据读回 (g1vec_deserialize)，不再重复校验。
+//
+// 一个 PointDecoder 同一时刻只处理一个调用 (内部加锁串行)；
+// 要并发解码的线程各用各的 PointDecoder。
+// ---------------------------------------------------------
+class PointDecoder {
+    std::vector<std::thread> workers;
+
+    std::mutex call_mutex;  // 串行化 decode 调用
+
+    // 当前任务：把 count 个点分成 chunk 个一段，各线程用 next 领取
+    std::mutex mutex;
+    std::condition_variable work_cv, done_cv;
+    uint64_t generation = 0;
+    bool stopping = false;
+    G1* out = nullptr;
+    const char* data = nullptr;
+    size_t count = 0;
+    int mode = 0;
+    std::atomic<size_t> next{0};
+    size_t num_chunks = 0;
+    size_t chunks_done = 0;
+    int active = 0;  // 正在 drain 的工作线程数
+    int64_t first_bad = -1;
+
+    void workerLoop();
+    // 领取并解码剩余的段，直到领完
+    void drain();
+
+   public:
+    // num_threads: 参与解码的线程数 (含调用线程)，<= 1 时就在调用线程里解码
+    explicit PointDecoder(int num_threads);
+    ~PointDecoder();
+
+    PointDecoder(const PointDecoder&) = delete;
+    PointDecoder& operator=(const PointDecoder&) = delete;
+
+    // 解码 n 个定长排列的点到 out，逐点校验 (见 g1vec_decode)。
+    // 返回第一个不合法的点的下标，全部合法时返回 -1
+    int64_t decode(G1* out, const char* data, size_t n, int mode);
+
+    // 解码一条线上格式的注册请求：id i64 | pk | xi[n] (与 RegJournal 的
+    // 记录 payload 相同)。长度不对或有不合法的点时返回 false
+    bool decodeRequest(const char* data, size_t bytes, int64_t n, int mode,
+                       RegRequest& out);
+};
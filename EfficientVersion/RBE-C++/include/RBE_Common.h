@@ -1,7 +1,9 @@
 // RBE_Common.h
 #pragma once
 #include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "mcl/bls12_381.hpp"
@@ -12,10 +14,18 @@ using namespace mcl::bn;
 // 全局初始化函数，必须在 main 开头调用
 inline void init_rbe_library() { initPairing(mcl::BLS12_381); }
 
+// 是否打印算法过程中的日志 (基准测试时关掉，避免终端输出干扰计时)
+inline bool rbe_verbose = true;
+
+class PairingTables;
+class FixedBaseTables;
+
 // 对应 Python 中的 objects.CRS
+// 用户 id、块号、row_id 以及 N、n 一律用 64 位整数：
+// row_id = k*n + i，用 int 的话在约 2^31 个槽位时就会溢出
 struct CRS {
-    int N;  // 最大用户数
-    int n;  // sqrt(N)
+    int64_t N;  // 最大用户数
+    int64_t n;  // sqrt(N)
     G1 g1;  // G1 生成元
     G2 g2;  // G2 生成元
 
@@ -24,10 +34,37 @@ struct CRS {
     std::vector<G1> h_g1;
     std::vector<G2> h_g2;
 
+    // e(h_{i+1}, h_{n-i}) = e(g1, g2)^{z^{n+1}}，与位置 i 无关，
+    // setup 时算一次，enc / dec 直接用，省掉每个密文分量的一次配对
+    GT e_zn1;
+
+    // g2 / h_g2 的 Miller loop 系数表 (可选，见 PairingTables.h 的
+    // crs_enable_precompute)；为空时配对照常计算
+    std::shared_ptr<PairingTables> tables;
+    // g2^r 与 e_zn1^r 的固定底数表 (可选，见 FixedBase.h)
+    std::shared_ptr<FixedBaseTables> fixed_base;
+
     // 构造函数：对应 Python setup 中的逻辑
-    CRS(int max_users) : N(max_users) { n = std::ceil(std::sqrt(N)); }
+    CRS(int64_t max_users) : N(max_users) {
+        n = std::ceil(std::sqrt((double)N));
+    }
 };
 
+// 延迟合并模式下每块最多这么多个尚未合并的组 (每组一个用户，见 reg_deferred)
+const int kRbePendingGroups = 4;
+
+// 暂存组占用 rbe_pending_level(n) 起的 kRbePendingGroups 层 (每组一层)。
+// 块内最多 n 人，二进制布局最高只用到 floor(log2 n) 层，不会和暂存层重叠
+inline int rbe_pending_level(int64_t n) {
+    return (int)std::ceil(std::log2(n)) + 2;
+}
+
+// 每块扫描的最高层号：enc / upd 扫描 0 .. rbe_max_level(n) (含暂存层)，
+// 各后端每块也按这么多层分配
+inline int rbe_max_level(int64_t n) {
+    return rbe_pending_level(n) + kRbePendingGroups - 1;
+}
+
 // 对应 Python 中的 keys
 struct UserKeys {
     Fr sk;               // 私钥 (标量)
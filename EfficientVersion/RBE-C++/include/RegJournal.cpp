@@ -0,0 +1,508 @@
+#include <RegJournal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+
+namespace {
+
+const char kJournalMagic[8] = {'R', 'B', 'E', 'J', 'R', 'N', 'L', '1'};
+// 版本 2：文件头加上 base_seq
+const uint32_t kJournalVersion = 2;
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t ser_mode;
+    int64_t n;
+    uint64_t base_seq;
+};
+
+// 记录长度的上限，超过视为损坏 (避免按坏掉的长度分配内存)
+const uint32_t kMaxPayload = 1u << 30;
+
+uint32_t fnv1a(const char* data, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void write_all(int fd, const char* data, size_t len, const std::string& path) {
+    while (len > 0) {
+        ssize_t w = write(fd, data, len);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            std::cerr << "Can't write journal: " << path << " ("
+                      << std::strerror(errno) << ")" << std::endl;
+            exit(1);
+        }
+        data += w;
+        len -= w;
+    }
+}
+
+bool read_exact(int fd, off_t off, char* out, size_t len) {
+    while (len > 0) {
+        ssize_t r = pread(fd, out, len, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        out += r;
+        off += r;
+        len -= r;
+    }
+    return true;
+}
+
+// 从 off 处读一条完整、校验通过的记录的 payload，并把 off 移到下一条；
+// 文件结束或记录损坏 (写了一半) 时返回 false
+bool read_record(int fd, off_t& off, std::string& payload) {
+    uint32_t len;
+    if (!read_exact(fd, off, (char*)&len, sizeof(len)) || len > kMaxPayload) {
+        return false;
+    }
+    payload.resize(len);
+    uint32_t checksum;
+    if (!read_exact(fd, off + sizeof(len), &payload[0], len) ||
+        !read_exact(fd, off + sizeof(len) + len, (char*)&checksum,
+                    sizeof(checksum)) ||
+        checksum != fnv1a(payload.data(), len)) {
+        return false;
+    }
+    off += sizeof(len) + len + sizeof(checksum);
+    return true;
+}
+
+// 单条记录 payload 的字节数
+size_t payload_size(int64_t n, int ser_mode) {
+    return sizeof(int64_t) + (1 + n) * g1_bin_size(ser_mode);
+}
+
+// 单条记录 (含长度与校验和) 的字节数
+size_t record_size(int64_t n, int ser_mode) {
+    return sizeof(uint32_t) + payload_size(n, ser_mode) + sizeof(uint32_t);
+}
+
+// 日志是 curator 自己写的，点在入口处已经校验过 (见 PointDecoder)，
+// 这里按存储层的数据还原 (g1vec_deserialize)，不再做子群检查
+bool decode_payload(const std::string& payload, int64_t n, int ser_mode,
+                    RegRequest& r) {
+    if (payload.size() != payload_size(n, ser_mode)) return false;
+    const size_t point_size = g1_bin_size(ser_mode);
+    std::memcpy(&r.id, payload.data(), sizeof(int64_t));
+    const char* points = payload.data() + sizeof(int64_t);
+    g1vec_deserialize(&r.pk, points, 1, ser_mode);
+    r.xi.resize(n);
+    g1vec_deserialize(r.xi.data(), points + point_size, n, ser_mode);
+    return true;
+}
+
+}  // namespace
+
+RegJournal::RegJournal(const std::string& path, int64_t n, int ser_mode)
+    : path(path), n(n), ser_mode(ser_mode) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "Can't open journal: " << path << " ("
+                  << std::strerror(errno) << ")" << std::endl;
+        exit(1);
+    }
+    struct stat st;
+    fstat(fd, &st);
+
+    JournalHeader header;
+    if (st.st_size == 0) {
+        writeHeader();
+        lseek(fd, sizeof(header), SEEK_SET);
+        return;
+    }
+
+    if (!read_exact(fd, 0, (char*)&header, sizeof(header)) ||
+        std::memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) !=
+            0 ||
+        header.version != kJournalVersion) {
+        std::cerr << "Bad journal header: " << path << std::endl;
+        exit(1);
+    }
+    if (header.n != n) {
+        std::cerr << "Journal block size " << header.n
+                  << " does not match CRS: " << path << std::endl;
+        exit(1);
+    }
+    this->ser_mode = header.ser_mode;
+    base_seq = header.base_seq;
+    applied_through = base_seq;
+
+    // 数出完整的记录，截掉崩溃时写了一半的尾部
+    off_t off = sizeof(header);
+    std::string payload;
+    appended_seq = base_seq;
+    while (read_record(fd, off, payload)) appended_seq++;
+    durable_seq = appended_seq;
+    if (off < st.st_size) {
+        std::cerr << "[Journal] Dropping " << (st.st_size - off)
+                  << " bytes of torn tail: " << path << std::endl;
+        if (ftruncate(fd, off) != 0) {
+            std::cerr << "Can't truncate journal: " << path << std::endl;
+            exit(1);
+        }
+        fdatasync(fd);
+    }
+    lseek(fd, off, SEEK_SET);
+}
+
+void RegJournal::writeHeader() {
+    JournalHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+    header.version = kJournalVersion;
+    header.ser_mode = ser_mode;
+    header.n = n;
+    header.base_seq = base_seq;
+    const char* p = (const char*)&header;
+    size_t len = sizeof(header);
+    off_t off = 0;
+    while (len > 0) {
+        ssize_t w = pwrite(fd, p, len, off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            std::cerr << "Can't write journal header: " << path << " ("
+                      << std::strerror(errno) << ")" << std::endl;
+            exit(1);
+        }
+        p += w;
+        off += w;
+        len -= w;
+    }
+    fdatasync(fd);
+}
+
+RegJournal::~RegJournal() {
+    if (fd < 0) return;
+    sync();
+    close(fd);
+}
+
+uint64_t RegJournal::append(const RegRequest& r) {
+    if ((int64_t)r.xi.size() != n) {
+        std::cerr << "[Journal] Rejected id " << r.id << ": " << r.xi.size()
+                  << " helping values, expected " << n << std::endl;
+        return 0;
+    }
+    const size_t point_size = g1_bin_size(ser_mode);
+    const uint32_t len = payload_size(n, ser_mode);
+
+    // 序列化放在锁外，只有拼进缓冲时持锁
+    std::string rec(sizeof(len) + len + sizeof(uint32_t), '\0');
+    char* p = &rec[0];
+    std::memcpy(p, &len, sizeof(len));
+    char* payload = p + sizeof(len);
+    std::memcpy(payload, &r.id, sizeof(int64_t));
+    g1vec_serialize(payload + sizeof(int64_t), &r.pk, 1, ser_mode);
+    g1vec_serialize(payload + sizeof(int64_t) + point_size, r.xi.data(), n,
+                    ser_mode);
+    uint32_t checksum = fnv1a(payload, len);
+    std::memcpy(payload + len, &checksum, sizeof(checksum));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffer += rec;
+    return ++appended_seq;
+}
+
+void RegJournal::waitDurable(uint64_t seq) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (durable_seq < seq) {
+        if (syncing) {
+            // 别的线程正在写出，等它完成后再看是否已经覆盖到 seq
+            synced_cv.wait(lock);
+            continue;
+        }
+        syncing = true;
+        std::string out;
+        out.swap(buffer);
+        uint64_t target = appended_seq;
+        lock.unlock();
+
+        write_all(fd, out.data(), out.size(), path);
+        if (fdatasync(fd) != 0) {
+            std::cerr << "Can't sync journal: " << path << " ("
+                      << std::strerror(errno) << ")" << std::endl;
+            exit(1);
+        }
+
+        lock.lock();
+        syncing = false;
+        durable_seq = target;
+        synced_cv.notify_all();
+    }
+}
+
+void RegJournal::sync() {
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seq = appended_seq;
+    }
+    waitDurable(seq);
+}
+
+uint64_t RegJournal::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return appended_seq;
+}
+
+uint64_t RegJournal::baseSeq() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return base_seq;
+}
+
+std::vector<RegRequest> RegJournal::readAll() {
+    std::vector<RegRequest> records, chunk;
+    uint64_t seq = baseSeq();
+    uint64_t last;
+    while ((last = readFrom(seq, 1024, chunk)) != seq) {
+        for (RegRequest& r : chunk) records.push_back(std::move(r));
+        seq = last;
+    }
+    return records;
+}
+
+uint64_t RegJournal::readFrom(uint64_t after, size_t max_records,
+                              std::vector<RegRequest>& out) {
+    sync();
+    out.clear();
+    uint64_t end;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (after < base_seq) after = base_seq;
+        end = durable_seq;
+    }
+    // 记录是定长的，直接定位到 after 之后的第一条
+    off_t off = sizeof(JournalHeader) +
+                (off_t)((after - base_seq) * record_size(n, ser_mode));
+    uint64_t seq = after;
+    std::string payload;
+    while (seq < end && out.size() < max_records &&
+           read_record(fd, off, payload)) {
+        seq++;
+        RegRequest r;
+        if (!decode_payload(payload, n, ser_mode, r)) {
+            std::cerr << "[Journal] Skipping malformed record " << seq << " ("
+                      << payload.size() << " bytes)" << std::endl;
+            continue;
+        }
+        out.push_back(std::move(r));
+    }
+    return seq;
+}
+
+void RegJournal::truncate() {
+    sync();
+    std::lock_guard<std::mutex> lock(mutex);
+    // 先把新的 base_seq 写进文件头再截断：两步之间崩溃时，残留记录的序号
+    // 只会偏大 (恢复时多重放几条)，不会和之后的新记录重号
+    base_seq = appended_seq;
+    writeHeader();
+    if (ftruncate(fd, sizeof(JournalHeader)) != 0) {
+        std::cerr << "Can't truncate journal: " << path << std::endl;
+        exit(1);
+    }
+    lseek(fd, sizeof(JournalHeader), SEEK_SET);
+    fdatasync(fd);
+    if (applied_through < base_seq) applied_through = base_seq;
+    applied_ahead.erase(applied_ahead.begin(),
+                        applied_ahead.upper_bound(applied_through));
+}
+
+void RegJournal::markApplied(uint64_t seq) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (seq <= applied_through) return;
+    applied_ahead.insert(seq);
+    // 补上了缺口就一直往后推
+    while (!applied_ahead.empty() &&
+           *applied_ahead.begin() == applied_through + 1) {
+        applied_through++;
+        applied_ahead.erase(applied_ahead.begin());
+    }
+}
+
+void RegJournal::markAppliedThrough(uint64_t seq) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (seq <= applied_through) return;
+    applied_through = seq;
+    applied_ahead.erase(applied_ahead.begin(),
+                        applied_ahead.upper_bound(applied_through));
+    while (!applied_ahead.empty() &&
+           *applied_ahead.begin() == applied_through + 1) {
+        applied_through++;
+        applied_ahead.erase(applied_ahead.begin());
+    }
+}
+
+uint64_t RegJournal::appliedThrough() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return applied_through;
+}
+
+uint64_t RegJournal::checkpointFor(uint64_t first, uint64_t last) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return first == applied_through + 1 ? last : applied_through;
+}
+
+// --- 只读的日志读取器 ---
+RegLogReader::RegLogReader(const std::string& path) {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Can't open registration log: " << path << " ("
+                  << std::strerror(errno) << ")" << std::endl;
+        return;
+    }
+    JournalHeader header;
+    if (!read_exact(fd, 0, (char*)&header, sizeof(header)) ||
+        std::memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) !=
+            0 ||
+        header.version != kJournalVersion || header.n <= 0) {
+        std::cerr << "Bad registration log header: " << path << std::endl;
+        close(fd);
+        fd = -1;
+        return;
+    }
+    n = header.n;
+    ser_mode = header.ser_mode;
+    offset = sizeof(header);
+
+    struct stat st;
+    fstat(fd, &st);
+    record_count = (st.st_size - sizeof(header)) / record_size(n, ser_mode);
+}
+
+RegLogReader::~RegLogReader() {
+    if (fd >= 0) close(fd);
+}
+
+int64_t RegLogReader::idAt(uint64_t index) {
+    int64_t id = -1;
+    read_exact(fd, sizeof(JournalHeader) + index * record_size(n, ser_mode) +
+                       sizeof(uint32_t),
+               (char*)&id, sizeof(id));
+    return id;
+}
+
+bool RegLogReader::nextPayload(std::string& payload) {
+    if (!ok() || corrupt_record) return false;
+    off_t before = offset;
+    if (read_record(fd, offset, payload)) return true;
+    // 读不出完整记录：如果后面还有字节，说明这条记录坏了
+    struct stat st;
+    fstat(fd, &st);
+    corrupt_record = (off_t)(before + record_size(n, ser_mode)) <= st.st_size;
+    return false;
+}
+
+bool RegLogReader::payloadAt(uint64_t index, std::string& payload) {
+    if (!ok() || index >= record_count) return false;
+    off_t off = sizeof(JournalHeader) + index * record_size(n, ser_mode);
+    if (read_record(fd, off, payload)) return true;
+    corrupt_record = true;
+    return false;
+}
+
+bool RegLogReader::decode(const std::string& payload, RegRequest& out) const {
+    return decode_payload(payload, n, ser_mode, out);
+}
+
+// --- 日志 + 存储 ---
+size_t reg_journaled(const CRS& crs, Storage* storage, RegJournal* journal,
+                     const std::vector<RegRequest>& requests) {
+    std::vector<uint64_t> seqs;
+    std::vector<RegRequest> accepted;
+    size_t rejected = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        uint64_t seq = journal->append(requests[i]);
+        if (seq == 0) {
+            // 第一次有请求被拒绝时才复制出被接受的部分
+            if (rejected++ == 0) {
+                accepted.assign(requests.begin(), requests.begin() + i);
+            }
+            continue;
+        }
+        if (rejected) accepted.push_back(requests[i]);
+        seqs.push_back(seq);
+    }
+    if (seqs.empty()) return rejected;
+    journal->waitDurable(seqs.back());
+
+    StorageBatch batch(storage);
+    // 并发追加时本批的序号可能不连续，这时只记之前已应用的
+    bool contiguous = seqs.back() - seqs.front() + 1 == seqs.size();
+    storage->setJournalCheckpoint(
+        contiguous ? journal->checkpointFor(seqs.front(), seqs.back())
+                   : journal->appliedThrough());
+    reg_batch(crs, storage, rejected ? accepted : requests);
+    if (!batch.commit()) {
+        // 记录已经在日志里，不标记为已应用，留给 recover_from_journal
+        std::cerr << "[Journal] Storage batch failed, " << seqs.size()
+                  << " requests not registered" << std::endl;
+        return requests.size();
+    }
+    for (uint64_t seq : seqs) journal->markApplied(seq);
+    return rejected;
+}
+
+int64_t recover_from_journal(const CRS& crs, Storage* storage,
+                             RegJournal* journal, size_t chunk) {
+    uint64_t base = journal->baseSeq();
+    uint64_t end = journal->size();
+    uint64_t done = storage->getJournalCheckpoint();
+    if (done > end) {
+        // 检查点比日志还新：日志不是这个存储的 (例如被删掉重建过)，全部重放
+        std::cerr << "[Journal] Storage checkpoint " << done
+                  << " is past the journal end " << end
+                  << ", replaying the whole journal" << std::endl;
+        done = base;
+    }
+    if (done < base) done = base;
+
+    int64_t fresh = 0;
+    uint64_t replayed = 0;
+    std::vector<RegRequest> records;
+    while (true) {
+        uint64_t last = journal->readFrom(done, chunk, records);
+        if (last == done) break;
+        std::set<int64_t> seen;
+        for (const RegRequest& r : records) {
+            if (seen.insert(r.id).second && !storage->isUserRegistered(r.id)) {
+                fresh++;
+            }
+        }
+        StorageBatch batch(storage);
+        reg_batch(crs, storage, records);
+        storage->setJournalCheckpoint(last);
+        if (!batch.commit()) {
+            // 检查点停在上一批，下次启动从那里接着重放
+            std::cerr << "[Journal] Storage batch failed while replaying "
+                      << "records after " << done << std::endl;
+            journal->markAppliedThrough(done);
+            return -1;
+        }
+        replayed += last - done;
+        done = last;
+    }
+    if (storage->getJournalCheckpoint() != done) {
+        // 没有可重放的记录时也把检查点对齐到这份日志
+        StorageBatch batch(storage);
+        storage->setJournalCheckpoint(done);
+        if (!batch.commit()) return -1;
+    }
+    journal->markAppliedThrough(done);
+
+    if (rbe_verbose)
+        std::cout << "[Journal] Replayed " << replayed << " records, "
+                  << fresh << " newly registered" << std::endl;
+    return fresh;
+}
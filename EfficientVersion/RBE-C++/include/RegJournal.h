@@ -0,0 +1,170 @@
+#pragma once
+#include <Storage.h>
+#include <algos.h>
+#include <my_utils.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------
+// 注册日志 (write-ahead journal)。
+// 只追加的文件，每条记录是一次注册的 (id, pk, xi)。注册先写日志并 fsync，
+// 再应用到存储；存储本身就不必每次提交都同步落盘 (例如 SQLite 在 WAL 下用
+// synchronous=NORMAL，见 SQLiteStorage::setSyncCommits)，持久性的代价变成
+// 每批一次顺序 fsync。
+//
+// 组提交 (group commit)：append 只写进内存缓冲；waitDurable(seq) 时第一个
+// 到达的线程把缓冲一次写出并 fdatasync，其余线程等它完成，一次 fsync
+// 覆盖期间所有线程追加的记录。
+//
+// 序号：每条记录有一个全局递增的序号 (从 1 开始)，truncate 之后继续往上数，
+// 文件头里的 base_seq 是文件中第一条记录之前的序号。
+//
+// 检查点：应用记录的批次里同时写进存储的检查点 (setJournalCheckpoint)，
+// 表示这个序号及之前的记录都已经应用、并和这批数据一起提交了。
+// 并发注册时记录的应用顺序和序号顺序不一致，所以检查点取 appliedThrough()：
+// 之前所有记录都已提交的最大序号 (markApplied 在提交之后调用)；本批的记录
+// 紧接在它后面时一起算进去 (checkpointFor)。
+//
+// 恢复：崩溃后打开日志会截掉写了一半的尾部记录；recover_from_journal 只读
+// 检查点之后的记录，分成有界的小批用 reg_batch 重放，每批连同新的检查点一起
+// 提交。已注册的 id 会被跳过，所以可以重复执行。这要求存储的批次是原子的
+// (SQLiteStorage / ShardedStorage，或包在它们外面的 CachingStorage)，否则
+// 崩溃时做了一半的合并无法识别；没有检查点的后端每次全部重放。
+// 启动时先恢复、再注册新请求。存储确认落盘后 (例如 SQLite 的一次同步提交)
+// 可以 truncate 日志。
+//
+// 点的来源：用户提交的请求在入口处解码并逐点校验一次
+// (PointDecoder::decodeRequest)，之后才追加进日志；日志是 curator 自己写的，
+// 读回时按可信数据还原 (g1vec_deserialize)，不再做子群检查。新建的日志默认
+// 用 affine 编码 (kJournalSerMode)，还原时只剩曲线方程检查，不用开平方根。
+//
+// 文件格式：
+//   header  magic[8] | version u32 | ser_mode i32 | n i64 | base_seq u64
+//   record  payload_len u32 | payload | checksum u32 (payload 的 FNV-1a)
+//   payload id i64 | pk | xi[n]        点为定长编码 (g1_bin_size(ser_mode))
+// ---------------------------------------------------------
+// 新建日志的点编码：affine 的记录大一倍，但还原时不用开平方根
+const int kJournalSerMode = mcl::IoEcAffineSerialize;
+
+class RegJournal {
+    int fd = -1;
+    std::string path;
+    int64_t n;
+    int ser_mode;
+
+    std::mutex mutex;
+    std::condition_variable synced_cv;
+    std::string buffer;         // 已追加、还没写进文件的记录
+    uint64_t base_seq = 0;      // 文件里第一条记录之前的序号
+    uint64_t appended_seq = 0;  // 最后一条已追加记录的序号
+    uint64_t durable_seq = 0;   // 最后一条已 fsync 记录的序号
+    bool syncing = false;       // 是否有线程正在写出 + fsync
+
+    // 已应用的记录：applied_through 及之前的全部，加上更靠后的零散几条
+    uint64_t applied_through = 0;
+    std::set<uint64_t> applied_ahead;
+
+    // 写文件头 (base_seq 取当前值)
+    void writeHeader();
+
+   public:
+    // 打开或创建日志文件。已有文件的块大小必须与 n 一致，点编码以文件为准
+    RegJournal(const std::string& path, int64_t n,
+               int ser_mode = kJournalSerMode);
+    ~RegJournal();
+
+    RegJournal(const RegJournal&) = delete;
+    RegJournal& operator=(const RegJournal&) = delete;
+
+    // 追加一条记录到内存缓冲，返回它的序号。xi 的长度不是 n 时拒绝，返回 0
+    uint64_t append(const RegRequest& r);
+    // 等到序号 seq 及之前的记录都已落盘 (组提交)
+    void waitDurable(uint64_t seq);
+    // 把缓冲里的全部记录写出并 fsync
+    void sync();
+
+    // 读出日志里已落盘的全部记录 (按追加顺序)
+    std::vector<RegRequest> readAll();
+    // 读序号 after 之后的记录，最多 max_records 条，放进 out (先清空)。
+    // 返回读到的最后一条记录的序号，没有更多记录时返回 after
+    uint64_t readFrom(uint64_t after, size_t max_records,
+                      std::vector<RegRequest>& out);
+    // 清空日志 (只保留文件头)，序号继续往上数。调用方保证存储已经落盘，
+    // 且没有并发的 append
+    void truncate();
+
+    // 序号 seq 的记录已经应用到存储、并且提交了
+    void markApplied(uint64_t seq);
+    // seq 及之前的记录都已应用 (恢复完成后调用)
+    void markAppliedThrough(uint64_t seq);
+    // 之前所有记录都已应用的最大序号，写进存储的检查点
+    uint64_t appliedThrough();
+    // 序号 first..last 的记录和检查点在同一个批次里提交时用的检查点：
+    // 它们紧接在 appliedThrough() 之后时为 last，否则为 appliedThrough()
+    uint64_t checkpointFor(uint64_t first, uint64_t last);
+
+    // 最后一条已追加记录的序号
+    uint64_t size();
+    // 文件里第一条记录之前的序号
+    uint64_t baseSeq();
+    int getSerMode() const { return ser_mode; }
+};
+
+// ---------------------------------------------------------
+// 顺序读取 RegJournal 格式的注册日志文件 (批量导入用)，不修改文件。
+// 记录是定长的，recordCount / idAt 只按偏移读 id，不读整条记录。
+// ---------------------------------------------------------
+class RegLogReader {
+    int fd = -1;
+    int64_t n = 0;
+    int ser_mode = SER_MODE;
+    uint64_t record_count = 0;
+    off_t offset = 0;  // 下一条记录的位置
+    bool corrupt_record = false;
+
+   public:
+    // 打开失败 (文件不存在、文件头不对) 时 ok() 为 false
+    explicit RegLogReader(const std::string& path);
+    ~RegLogReader();
+
+    RegLogReader(const RegLogReader&) = delete;
+    RegLogReader& operator=(const RegLogReader&) = delete;
+
+    bool ok() const { return fd >= 0; }
+    int64_t blockSize() const { return n; }
+    int getSerMode() const { return ser_mode; }
+    // 文件里完整记录的条数 (按文件大小算，不含写了一半的尾部)
+    uint64_t recordCount() const { return record_count; }
+    // 第 index 条记录的 id
+    int64_t idAt(uint64_t index);
+
+    // 读下一条记录的 payload (未解码)。读完或遇到损坏的记录时返回 false，
+    // 后者 corrupt() 为 true
+    bool nextPayload(std::string& payload);
+    // 读第 index 条记录的 payload (不影响 nextPayload 的位置)。
+    // 记录损坏时返回 false，corrupt() 为 true
+    bool payloadAt(uint64_t index, std::string& payload);
+    bool corrupt() const { return corrupt_record; }
+
+    // 把一条 payload 还原成 RegRequest (可信数据，见 RegJournal 的说明)，
+    // 大小不对时返回 false
+    bool decode(const std::string& payload, RegRequest& out) const;
+};
+
+// 先把整批记录写进日志并 fsync 一次，再用 reg_batch 应用到存储
+// (连同检查点在同一个批次里提交)。xi 长度不对的请求不写日志、不注册，
+// 返回被拒绝的请求数。存储的批次失败时整批都算被拒绝 (记录已经在日志里，
+// 下次 recover_from_journal 时补上)
+size_t reg_journaled(const CRS& crs, Storage* storage, RegJournal* journal,
+                     const std::vector<RegRequest>& requests);
+
+// 启动时调用：重放存储检查点之后的记录，每 chunk 条一批，
+// 返回实际新注册的人数。存储的批次失败时返回 -1 (检查点停在最后一次
+// 成功提交的那一批)
+int64_t recover_from_journal(const CRS& crs, Storage* storage,
+                             RegJournal* journal, size_t chunk = 256);
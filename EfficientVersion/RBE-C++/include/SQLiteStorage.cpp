@@ -11,19 +11,56 @@ void SQLiteStorage::exec_sql(const char* sql) {
     }
 }
 
-SQLiteStorage::SQLiteStorage(const std::string& db_path) {
+SQLiteStorage::SQLiteStorage(const std::string& db_path, int ser_mode,
+                             int64_t legacy_block_size)
+    : ser_mode(ser_mode) {
     int rc = sqlite3_open(db_path.c_str(), &db);
     if (rc) {
         std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
         exit(1);
     }
+    // 多个连接 (多个进程或多个 SQLiteStorage 实例) 同时打开同一个库时，
+    // 遇到写锁先等待而不是立刻返回 SQLITE_BUSY；WAL 模式下读写互不阻塞
+    sqlite3_busy_timeout(db, 5000);
+    exec_sql("PRAGMA journal_mode=WAL;");
     initTables();
+    prepareStatements();
+    block_size = loadMeta("block_size", 0);
+
+    // 点编码是模式的一部分：已有的库以 meta 表里记录的为准
+    int stored_mode = (int)loadMeta("ser_mode", -1);
+    bool legacy = hasLegacyAux();
+    if (stored_mode == -1) {
+        // 新库记录本次选择的编码；没有该条目但已有数据的旧库一定是压缩编码
+        if (block_size != 0 || legacy) this->ser_mode = mcl::IoSerialize;
+        saveMeta("ser_mode", this->ser_mode);
+    } else if (stored_mode != this->ser_mode) {
+        std::cerr << "[SQLite] Database uses point encoding " << stored_mode
+                  << ", ignoring requested " << this->ser_mode << std::endl;
+        this->ser_mode = stored_mode;
+    }
+
+    // 旧版的逐行 aux 表：不转换的话 readAuxVector 什么也读不到，合并时把
+    // 缺失的 Aux 当成 0，会悄悄写坏每个块，所以宁可拒绝打开
+    if (legacy && !migrateLegacyAux(legacy_block_size)) {
+        std::cerr << "Can't open database " << db_path
+                  << ": it stores aux values in the legacy per-row `aux` "
+                     "table and its block size is unknown; open it once "
+                     "with legacy_block_size = n to convert it"
+                  << std::endl;
+        exit(1);
+    }
 }
 
-SQLiteStorage::~SQLiteStorage() { sqlite3_close(db); }
+SQLiteStorage::~SQLiteStorage() {
+    for (int i = 0; i < STMT_COUNT; ++i) {
+        sqlite3_finalize(stmts[i]);
+    }
+    sqlite3_close(db);
+}
 
 void SQLiteStorage::initTables() {
-    // 创建四张表：keys, pp, aux, counts
+    // 创建六张表：keys, pp, aux_vec, counts, block_users, meta
     // OR REPLACE 语法是 SQLite 的特性，如果 ID 重复直接覆盖
     exec_sql(
         "CREATE TABLE IF NOT EXISTS users (id INTEGER PRIMARY KEY, pk "
@@ -31,56 +68,129 @@ void SQLiteStorage::initTables() {
     exec_sql(
         "CREATE TABLE IF NOT EXISTS pp (block_id INTEGER, level INTEGER, "
         "commitment BLOB, PRIMARY KEY (block_id, level));");
+    // 每个 (块, 层) 的 n 个 Aux 点拼成一个 BLOB，第 i 个位置在偏移
+    // i * g1_bin_size(ser_mode) 处；单行读取用 substr 切片
     exec_sql(
-        "CREATE TABLE IF NOT EXISTS aux (row_id INTEGER, level INTEGER, "
-        "upd BLOB, PRIMARY KEY (row_id, level));");
+        "CREATE TABLE IF NOT EXISTS aux_vec (block_id INTEGER, level "
+        "INTEGER, vec BLOB, PRIMARY KEY (block_id, level));");
     exec_sql(
         "CREATE TABLE IF NOT EXISTS counts (block_id INTEGER, level "
         "INTEGER, count INTEGER, PRIMARY KEY (block_id, level));");
+    // 每块已落座的用户数，它的二进制位就是 counts 表里各层的占用
+    exec_sql(
+        "CREATE TABLE IF NOT EXISTS block_users (block_id INTEGER PRIMARY "
+        "KEY, count INTEGER);");
+    // 模式相关的元数据，例如块大小 n (row_id -> (block, offset) 需要它)
+    exec_sql(
+        "CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value "
+        "INTEGER);");
+}
+
+void SQLiteStorage::prepareStatements() {
+    // 下标与 StmtId 一一对应
+    static const char* const sqls[STMT_COUNT] = {
+        "SELECT count(*) FROM users WHERE id = ?",
+        // INSERT OR REPLACE: 如果 ID 存在则更新，不存在则插入
+        "INSERT OR REPLACE INTO users (id, pk) VALUES (?, ?)",
+        "SELECT pk FROM users WHERE id = ?",
+        "SELECT commitment FROM pp WHERE block_id = ? AND level = ?",
+        "INSERT OR REPLACE INTO pp (block_id, level, commitment) VALUES "
+        "(?, ?, ?)",
+        "DELETE FROM pp WHERE block_id = ? AND level = ?",
+        // substr 的下标从 1 开始，按字节切出某一个位置的点
+        "SELECT substr(vec, ?, ?) FROM aux_vec WHERE block_id = ? AND "
+        "level = ?",
+        "SELECT vec FROM aux_vec WHERE block_id = ? AND level = ?",
+        "INSERT OR REPLACE INTO aux_vec (block_id, level, vec) VALUES (?, "
+        "?, ?)",
+        "DELETE FROM aux_vec WHERE block_id = ? AND level = ?",
+        "SELECT count FROM counts WHERE block_id = ? AND level = ?",
+        "INSERT OR REPLACE INTO counts (block_id, level, count) VALUES (?, "
+        "?, ?)",
+        // 没有 block_users 记录时，把有人的层 (?2 以下，不含暂存层)
+        // 对应的位加起来
+        "SELECT COALESCE((SELECT count FROM block_users WHERE block_id = "
+        "?1), (SELECT COALESCE(SUM(1 << level), 0) FROM counts WHERE "
+        "block_id = ?1 AND level < ?2 AND count != 0))",
+        "INSERT OR REPLACE INTO block_users (block_id, count) VALUES (?, ?)",
+        "SELECT 1 FROM aux_vec WHERE block_id = ? AND level = ?",
+        "SELECT value FROM meta WHERE key = ?",
+        "INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?)",
+        // IMMEDIATE: 开始时就拿写锁，避免多个连接在事务中途升级锁时死锁
+        "BEGIN IMMEDIATE",
+        "COMMIT",
+        "ROLLBACK",
+    };
+    for (int i = 0; i < STMT_COUNT; ++i) {
+        if (sqlite3_prepare_v2(db, sqls[i], -1, &stmts[i], 0) != SQLITE_OK) {
+            std::cerr << "[SQLite Error] " << sqlite3_errmsg(db)
+                      << "\nSQL: " << sqls[i] << std::endl;
+            exit(1);
+        }
+    }
+}
+
+bool SQLiteStorage::step_simple(StmtId id) {
+    StmtScope scope(stmts[id]);
+    if (sqlite3_step(scope.stmt) != SQLITE_DONE) {
+        std::cerr << "[SQLite Error] " << sqlite3_errmsg(db)
+                  << "\nSQL: " << sqlite3_sql(scope.stmt) << std::endl;
+        return false;
+    }
+    return true;
 }
 
 // --- 实现接口: isUserRegistered ---
-bool SQLiteStorage::isUserRegistered(int id) {
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT count(*) FROM users WHERE id = ?";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, id);
+bool SQLiteStorage::isUserRegistered(int64_t id) {
+    StmtScope scope(stmts[STMT_IS_USER_REGISTERED]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, id);
 
     bool exists = false;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         int count = sqlite3_column_int(stmt, 0);
         exists = (count > 0);
     }
-    sqlite3_finalize(stmt);
     return exists;
 }
 
 // --- 实现接口: saveUserPublicKey ---
-void SQLiteStorage::saveUserPublicKey(int id, const G1& pk) {
-    std::string blob = g1_to_bin(pk);
-    sqlite3_stmt* stmt;
-    // INSERT OR REPLACE: 如果 ID 存在则更新，不存在则插入
-    std::string sql = "INSERT OR REPLACE INTO users (id, pk) VALUES (?, ?)";
-
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, id);
+void SQLiteStorage::saveUserPublicKey(int64_t id, const G1& pk) {
+    if (writesDropped()) return;
+    char blob[kG1MaxBinSize];
+    size_t bytes = pk.serialize(blob, sizeof(blob), ser_mode);
+    StmtScope scope(stmts[STMT_SAVE_USER_PK]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, id);
     // 绑定二进制数据 (BLOB)
-    sqlite3_bind_blob(stmt, 2, blob.c_str(), blob.size(), SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 2, blob, bytes, SQLITE_STATIC);
 
     if (sqlite3_step(stmt) != SQLITE_DONE) {
         std::cerr << "Error saving user pk: " << sqlite3_errmsg(db)
                   << std::endl;
     }
-    sqlite3_finalize(stmt);
+}
+
+// --- 实现接口: getUserPublicKey ---
+G1 SQLiteStorage::getUserPublicKey(int64_t id) {
+    StmtScope scope(stmts[STMT_GET_USER_PK]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, id);
+    G1 result;
+    result.clear();
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void* data = sqlite3_column_blob(stmt, 0);
+        int bytes = sqlite3_column_bytes(stmt, 0);
+        result = stored_bin_to_g1((const char*)data, bytes, ser_mode);
+    }
+    return result;
 }
 
 // --- 实现接口: getPPCommitment ---
-G1 SQLiteStorage::getPPCommitment(int block_index, int level) {
-    sqlite3_stmt* stmt;
-    std::string sql =
-        "SELECT commitment FROM pp WHERE block_id = ? AND level = ?";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, block_index);
+G1 SQLiteStorage::getPPCommitment(int64_t block_index, int level) {
+    StmtScope scope(stmts[STMT_GET_PP]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
     sqlite3_bind_int(stmt, 2, level);
     G1 result;
     result.clear();  // 默认设为 0
@@ -88,126 +198,357 @@ G1 SQLiteStorage::getPPCommitment(int block_index, int level) {
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         const void* data = sqlite3_column_blob(stmt, 0);
         int bytes = sqlite3_column_bytes(stmt, 0);
-        std::string s((const char*)data, bytes);
-        result = bin_to_g1(s);
+        result = stored_bin_to_g1((const char*)data, bytes, ser_mode);
     }
-    sqlite3_finalize(stmt);
     return result;
 }
 
 // --- 实现接口: savePPCommitment ---
-void SQLiteStorage::savePPCommitment(int block_index, int level,
+void SQLiteStorage::savePPCommitment(int64_t block_index, int level,
                                      const G1& com) {
-    std::string blob = g1_to_bin(com);
-    sqlite3_stmt* stmt;
-    std::string sql =
-        "INSERT OR REPLACE INTO pp (block_id, level, commitment) VALUES "
-        "(?, ?, ?)";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, block_index);
+    if (writesDropped()) return;
+    char blob[kG1MaxBinSize];
+    size_t bytes = com.serialize(blob, sizeof(blob), ser_mode);
+    StmtScope scope(stmts[STMT_SAVE_PP]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
     sqlite3_bind_int(stmt, 2, level);
-    sqlite3_bind_blob(stmt, 3, blob.c_str(), blob.size(), SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 3, blob, bytes, SQLITE_STATIC);
 
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
 }
 
 // --- 实现接口: deletePPCommitment ---
-void SQLiteStorage::deletePPCommitment(int block_index, int level) {
-    sqlite3_stmt* stmt;
-    std::string sql = "DELETE FROM pp WHERE block_id = ? AND level = ?";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, block_index);
+void SQLiteStorage::deletePPCommitment(int64_t block_index, int level) {
+    if (writesDropped()) return;
+    StmtScope scope(stmts[STMT_DELETE_PP]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
     sqlite3_bind_int(stmt, 2, level);
 
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
 }
 
 // --- 实现接口: getAuxUpdate ---
-G1 SQLiteStorage::getAuxUpdate(int row_id, int level) {
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT upd FROM aux WHERE row_id = ? AND level = ?";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, row_id);
-    sqlite3_bind_int(stmt, 2, level);
+// 只从整向量 BLOB 里切出 row_id 对应的那一个点
+G1 SQLiteStorage::getAuxUpdate(int64_t row_id, int level) {
     G1 result;
     result.clear();
+    if (block_size == 0) return result;  // 还没有存过任何 Aux 向量
+
+    const int point_size = g1_bin_size(ser_mode);
+    StmtScope scope(stmts[STMT_GET_AUX]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, (row_id % block_size) * point_size + 1);
+    sqlite3_bind_int(stmt, 2, point_size);
+    sqlite3_bind_int64(stmt, 3, row_id / block_size);
+    sqlite3_bind_int(stmt, 4, level);
 
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         const void* data = sqlite3_column_blob(stmt, 0);
         int bytes = sqlite3_column_bytes(stmt, 0);
-        std::string s((const char*)data, bytes);
-        result = bin_to_g1(s);
+        result = stored_bin_to_g1((const char*)data, bytes, ser_mode);
     }
-    sqlite3_finalize(stmt);
     return result;
 }
 
 // --- 实现接口: saveAuxUpdate ---
-void SQLiteStorage::saveAuxUpdate(int row_id, int level, const G1& upd) {
-    std::string blob = g1_to_bin(upd);
-    sqlite3_stmt* stmt;
-    std::string sql =
-        "INSERT OR REPLACE INTO aux (row_id, level, upd) VALUES (?, ?, ?)";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, row_id);
+// 单点写入需要读-改-写整个向量，代价 O(n)；批量路径请用 saveAuxVector
+void SQLiteStorage::saveAuxUpdate(int64_t row_id, int level, const G1& upd) {
+    if (block_size == 0) {
+        std::cerr << "Error saving aux update: block size unknown, save a "
+                     "whole aux vector first"
+                  << std::endl;
+        return;
+    }
+    int64_t block_index = row_id / block_size;
+    std::vector<G1> vec = getAuxVector(block_index, level);
+    if (vec.empty()) {
+        vec.resize(block_size);
+        for (G1& p : vec) p.clear();
+    }
+    vec[row_id % block_size] = upd;
+    saveAuxVector(block_index, level, vec);
+}
+
+// --- 实现接口: deleteAuxUpdate ---
+// 整向量存储下单点删除等价于把该位置清零；整层删除请用 deleteAuxVector
+void SQLiteStorage::deleteAuxUpdate(int64_t row_id, int level) {
+    if (block_size == 0) return;
+    int64_t block_index = row_id / block_size;
+    std::vector<G1> vec = getAuxVector(block_index, level);
+    if (vec.empty()) return;
+    vec[row_id % block_size].clear();
+    saveAuxVector(block_index, level, vec);
+}
+
+// --- 实现接口: getAuxVector ---
+std::vector<G1> SQLiteStorage::getAuxVector(int64_t block_index, int level) {
+    std::vector<G1> result;
+    if (!readAuxVector(block_index, level, result)) result.clear();
+    return result;
+}
+
+bool SQLiteStorage::readAuxVector(int64_t block_index, int level,
+                                  std::vector<G1>& out) {
+    StmtScope scope(stmts[STMT_GET_AUX_VEC]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
     sqlite3_bind_int(stmt, 2, level);
-    sqlite3_bind_blob(stmt, 3, blob.c_str(), blob.size(), SQLITE_STATIC);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) return false;
+    const void* data = sqlite3_column_blob(stmt, 0);
+    int bytes = sqlite3_column_bytes(stmt, 0);
+    // 直接从 SQLite 的缓冲解码到 out，不经过中间向量
+    out.resize(bytes / g1_bin_size(ser_mode));
+    g1vec_deserialize(out.data(), (const char*)data, out.size(), ser_mode);
+    return !out.empty();
+}
+
+// --- 实现接口: saveAuxVector ---
+void SQLiteStorage::saveAuxVector(int64_t block_index, int level,
+                                  const std::vector<G1>& vec) {
+    if (writesDropped()) return;
+    // 长度不对的向量一律不写：getAuxUpdate 按 block_size 算 substr 的偏移
+    if (vec.empty() ||
+        (block_size != 0 && (int64_t)vec.size() != block_size)) {
+        std::cerr << "Error saving aux vector: expected " << block_size
+                  << " points, got " << vec.size() << std::endl;
+        return;
+    }
+    if (block_size == 0) {
+        // 第一次写入时确定块大小，并记录到 meta 表 (批次回滚时一起撤销，
+        // 见 endBatch)
+        block_size = vec.size();
+        saveMeta("block_size", block_size);
+    }
+
+    // 序列化缓冲是成员，一直复用 (SQLiteStorage 同一时刻只有一个线程在用)
+    aux_blob.resize(vec.size() * g1_bin_size(ser_mode));
+    g1vec_serialize(&aux_blob[0], vec.data(), vec.size(), ser_mode);
+    StmtScope scope(stmts[STMT_SAVE_AUX_VEC]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
+    sqlite3_bind_int(stmt, 2, level);
+    sqlite3_bind_blob(stmt, 3, aux_blob.data(), aux_blob.size(),
+                      SQLITE_STATIC);
 
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
 }
 
-// --- 实现接口: deleteAuxUpdate ---
-void SQLiteStorage::deleteAuxUpdate(int row_id, int level) {
-    sqlite3_stmt* stmt;
-    std::string sql = "DELETE FROM aux WHERE row_id = ? AND level = ?";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, row_id);
+// --- 实现接口: deleteAuxVector ---
+void SQLiteStorage::deleteAuxVector(int64_t block_index, int level) {
+    if (writesDropped()) return;
+    StmtScope scope(stmts[STMT_DELETE_AUX_VEC]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
     sqlite3_bind_int(stmt, 2, level);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
 }
 
 // --- 实现接口: getUserCountInLevel ---
-int SQLiteStorage::getUserCountInLevel(int block_index, int level) {
-    sqlite3_stmt* stmt;
-    std::string sql =
-        "SELECT count FROM counts WHERE block_id = ? AND level = ?";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, block_index);
+int64_t SQLiteStorage::getUserCountInLevel(int64_t block_index, int level) {
+    StmtScope scope(stmts[STMT_GET_COUNT]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
     sqlite3_bind_int(stmt, 2, level);
-    int result = 0;
+    int64_t result = 0;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        result = sqlite3_column_int(stmt, 0);
+        result = sqlite3_column_int64(stmt, 0);
     }
-    sqlite3_finalize(stmt);
     return result;
 }
 
 // --- 实现接口: setUserCountInLevel ---
-void SQLiteStorage::setUserCountInLevel(int block_index, int level, int count) {
-    sqlite3_stmt* stmt;
-    std::string sql =
-        "INSERT OR REPLACE INTO counts (block_id, level, count) VALUES (?, "
-        "?, ?)";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, block_index);
+void SQLiteStorage::setUserCountInLevel(int64_t block_index, int level,
+                                        int64_t count) {
+    if (writesDropped()) return;
+    StmtScope scope(stmts[STMT_SET_COUNT]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
     sqlite3_bind_int(stmt, 2, level);
-    sqlite3_bind_int(stmt, 3, count);
+    sqlite3_bind_int64(stmt, 3, count);
+    sqlite3_step(stmt);
+}
+
+// --- 实现接口: getBlockUserCount ---
+int64_t SQLiteStorage::getBlockUserCount(int64_t block_index) {
+    StmtScope scope(stmts[STMT_GET_BLOCK_USERS]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
+    // 块大小未知时还没有任何层数据，上界取多少都一样
+    sqlite3_bind_int(stmt, 2,
+                     block_size == 0 ? 64 : rbe_pending_level(block_size));
+    int64_t result = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        result = sqlite3_column_int64(stmt, 0);
+    }
+    return result;
+}
+
+// --- 实现接口: setBlockUserCount ---
+void SQLiteStorage::setBlockUserCount(int64_t block_index, int64_t count) {
+    if (writesDropped()) return;
+    StmtScope scope(stmts[STMT_SET_BLOCK_USERS]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, block_index);
+    sqlite3_bind_int64(stmt, 2, count);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
 }
 
 // --- 实现接口: hasAux ---
-bool SQLiteStorage::hasAux(int row_id, int level) {
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT 1 FROM aux WHERE row_id = ? AND level = ?";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0);
-    sqlite3_bind_int(stmt, 1, row_id);
+bool SQLiteStorage::hasAux(int64_t row_id, int level) {
+    if (block_size == 0) return false;
+    StmtScope scope(stmts[STMT_HAS_AUX]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_int64(stmt, 1, row_id / block_size);
     sqlite3_bind_int(stmt, 2, level);
     bool exists = (sqlite3_step(stmt) == SQLITE_ROW);
+    return exists;
+}
+
+// --- 实现接口: 注册日志的检查点 ---
+uint64_t SQLiteStorage::getJournalCheckpoint() {
+    return (uint64_t)loadMeta("journal_checkpoint", 0);
+}
+
+void SQLiteStorage::setJournalCheckpoint(uint64_t seq) {
+    saveMeta("journal_checkpoint", (int64_t)seq);
+}
+
+bool SQLiteStorage::hasJournalCheckpoint() {
+    return loadMeta("journal_checkpoint", -1) >= 0;
+}
+
+void SQLiteStorage::setSyncCommits(bool sync) {
+    exec_sql(sync ? "PRAGMA synchronous=FULL;" : "PRAGMA synchronous=NORMAL;");
+}
+
+// --- 元数据 ---
+int64_t SQLiteStorage::loadMeta(const char* key, int64_t default_value) {
+    StmtScope scope(stmts[STMT_GET_META]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+    int64_t result = default_value;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        result = sqlite3_column_int64(stmt, 0);
+    }
+    return result;
+}
+
+void SQLiteStorage::saveMeta(const char* key, int64_t value) {
+    if (writesDropped()) return;
+    StmtScope scope(stmts[STMT_SET_META]);
+    sqlite3_stmt* stmt = scope.stmt;
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, value);
+    sqlite3_step(stmt);
+}
+
+// --- 旧版 aux 表的转换 ---
+bool SQLiteStorage::hasLegacyAux() {
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db,
+                       "SELECT 1 FROM sqlite_master WHERE type = 'table' AND "
+                       "name = 'aux'",
+                       -1, &stmt, 0);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
     sqlite3_finalize(stmt);
     return exists;
 }
+
+// 旧版的 aux 表：(row_id, level, upd)，row_id = k*n + i，点是压缩编码。
+// 按 (块, 层) 分组拼成长度为 n 的向量写进 aux_vec，缺的位置为 0，
+// 然后删掉 aux 表；整个转换在一个事务里
+bool SQLiteStorage::migrateLegacyAux(int64_t n) {
+    if (n <= 0) n = block_size;
+    sqlite3_stmt* stmt;
+    sqlite3_prepare_v2(db, "SELECT count(*) FROM aux", -1, &stmt, 0);
+    int64_t rows = sqlite3_step(stmt) == SQLITE_ROW
+                       ? sqlite3_column_int64(stmt, 0)
+                       : 0;
+    sqlite3_finalize(stmt);
+    if (rows > 0 && n <= 0) return false;
+    if (rows > 0 && block_size != 0 && block_size != n) {
+        std::cerr << "[SQLite] Legacy aux conversion: block size " << n
+                  << " does not match stored " << block_size << std::endl;
+        return false;
+    }
+
+    beginBatch();
+    if (batch_failed) {
+        // 拿不到写锁：不能在事务外半途转换
+        std::cerr << "[SQLite] Legacy aux conversion: can't start a "
+                     "transaction"
+                  << std::endl;
+        exit(1);
+    }
+    if (rows > 0) {
+        sqlite3_prepare_v2(db,
+                           "SELECT row_id, level, upd FROM aux ORDER BY "
+                           "row_id / ?1, level, row_id",
+                           -1, &stmt, 0);
+        sqlite3_bind_int64(stmt, 1, n);
+        std::vector<G1> vec;
+        int64_t cur_block = -1;
+        int cur_level = -1;
+        auto flush = [&]() {
+            if (cur_block >= 0) saveAuxVector(cur_block, cur_level, vec);
+        };
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int64_t row_id = sqlite3_column_int64(stmt, 0);
+            int level = sqlite3_column_int(stmt, 1);
+            if (row_id / n != cur_block || level != cur_level) {
+                flush();
+                cur_block = row_id / n;
+                cur_level = level;
+                vec.assign(n, G1());
+                for (G1& p : vec) p.clear();
+            }
+            const void* data = sqlite3_column_blob(stmt, 2);
+            int bytes = sqlite3_column_bytes(stmt, 2);
+            vec[row_id % n] =
+                stored_bin_to_g1((const char*)data, bytes, mcl::IoSerialize);
+        }
+        flush();
+        sqlite3_finalize(stmt);
+    }
+    exec_sql("DROP TABLE aux;");
+    commitBatch();
+    if (rows > 0) {
+        std::cerr << "[SQLite] Converted " << rows
+                  << " legacy aux rows (n=" << n << ")" << std::endl;
+    }
+    return true;
+}
+
+// --- 实现接口: 批处理 ---
+// BEGIN 失败 (如等锁超过 busy_timeout 仍是 SQLITE_BUSY) 时没有事务，
+// 批次直接记为失败，之后的写入全部丢弃，不会以自动提交方式零散生效。
+// COMMIT 失败时事务还开着，回滚掉，同样记为失败。
+void SQLiteStorage::beginBatch() {
+    if (batch_depth++ == 0) {
+        batch_failed = !step_simple(STMT_BEGIN);
+    }
+}
+
+void SQLiteStorage::commitBatch() {
+    if (batch_depth == 0) return;  // 没有配对的 begin
+    if (--batch_depth == 0) {
+        if (!batch_failed && !step_simple(STMT_COMMIT)) batch_failed = true;
+        endBatch();
+    }
+}
+
+void SQLiteStorage::rollbackBatch() {
+    if (batch_depth == 0) return;
+    batch_failed = true;
+    if (--batch_depth == 0) endBatch();
+}
+
+void SQLiteStorage::endBatch() {
+    if (!batch_failed) return;
+    if (!sqlite3_get_autocommit(db)) step_simple(STMT_ROLLBACK);
+    // 批次里第一次写入时定下的块大小随 meta 一起回滚了，内存里的也要撤销
+    block_size = loadMeta("block_size", 0);
+}
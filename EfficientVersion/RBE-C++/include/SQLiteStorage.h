@@ -10,46 +10,175 @@
 class SQLiteStorage : public Storage {
     sqlite3* db;
 
+    // 预编译语句的编号：每条 SQL 只在构造时 prepare 一次，之后反复复用
+    enum StmtId {
+        STMT_IS_USER_REGISTERED,
+        STMT_SAVE_USER_PK,
+        STMT_GET_USER_PK,
+        STMT_GET_PP,
+        STMT_SAVE_PP,
+        STMT_DELETE_PP,
+        STMT_GET_AUX,
+        STMT_GET_AUX_VEC,
+        STMT_SAVE_AUX_VEC,
+        STMT_DELETE_AUX_VEC,
+        STMT_GET_COUNT,
+        STMT_SET_COUNT,
+        STMT_GET_BLOCK_USERS,
+        STMT_SET_BLOCK_USERS,
+        STMT_HAS_AUX,
+        STMT_GET_META,
+        STMT_SET_META,
+        STMT_BEGIN,
+        STMT_COMMIT,
+        STMT_ROLLBACK,
+        STMT_COUNT  // 语句总数，不是真正的语句
+    };
+    sqlite3_stmt* stmts[STMT_COUNT];
+
+    // 批处理嵌套深度；只有最外层才真正 BEGIN / COMMIT
+    int batch_depth = 0;
+    // 当前 (或刚结束的最外层) 批次失败：BEGIN / COMMIT 失败，或内层回滚过
+    bool batch_failed = false;
+    // 批次已经失败时写入直接丢弃 (见 beginBatch)
+    bool writesDropped() const { return batch_depth > 0 && batch_failed; }
+
+    // 块大小 n：Aux 按 (块, 层) 整向量存储，单行访问时用它把 row_id
+    // 换算成 (块号, 块内偏移)。第一次 saveAuxVector 时确定并写入 meta 表，
+    // 0 表示还未知
+    int64_t block_size = 0;
+
+    // 点编码 (见 my_utils.h)，记录在 meta 表的 ser_mode 中
+    int ser_mode;
+
+    // saveAuxVector 的序列化缓冲，一直复用
+    std::string aux_blob;
+
+    // 借用一条缓存的语句；离开作用域时自动 reset + clear_bindings，
+    // 这样语句不会一直持有读锁，绑定的 BLOB 也不会悬空
+    struct StmtScope {
+        sqlite3_stmt* stmt;
+        explicit StmtScope(sqlite3_stmt* s) : stmt(s) {}
+        ~StmtScope() {
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+        }
+        StmtScope(const StmtScope&) = delete;
+        StmtScope& operator=(const StmtScope&) = delete;
+    };
+
     // 辅助：执行无返回值的 SQL (如 CREATE TABLE)
     void exec_sql(const char* sql);
 
+    // 辅助：一次性编译所有语句
+    void prepareStatements();
+
+    // 辅助：执行一条缓存的无参数语句 (BEGIN / COMMIT / ROLLBACK)，
+    // 失败时返回 false
+    bool step_simple(StmtId id);
+
+    // 最外层批次结束：失败时回滚事务，并从 meta 表重新读出块大小
+    void endBatch();
+
+    // 辅助：读写 meta 表
+    int64_t loadMeta(const char* key, int64_t default_value);
+    void saveMeta(const char* key, int64_t value);
+
+    // 旧版库把 Aux 按 (row_id, level) 逐行存在 aux 表里，打开时转换成
+    // aux_vec 的整向量；返回 false 表示无法转换 (不知道块大小)
+    bool hasLegacyAux();
+    bool migrateLegacyAux(int64_t n);
+
    public:
-    SQLiteStorage(const std::string& db_path);
+    // ser_mode: 新建库时使用的点编码。压缩编码 (默认) 省一半空间；
+    // mcl::IoEcAffineSerialize 读取时不需要开方，读多的场景更快。
+    // 打开已有的库时以库里记录的编码为准。
+    // legacy_block_size: 块大小 n，只在打开旧版 (Aux 逐行存放) 的库时用于
+    // 转换；旧版库没有记录 n，不提供时拒绝打开 (转换后不再需要)
+    SQLiteStorage(const std::string& db_path, int ser_mode = SER_MODE,
+                  int64_t legacy_block_size = 0);
 
     ~SQLiteStorage();
 
+    SQLiteStorage(const SQLiteStorage&) = delete;
+    SQLiteStorage& operator=(const SQLiteStorage&) = delete;
+
     void initTables();
 
+    // 当前实际使用的点编码
+    int getSerMode() const { return ser_mode; }
+
+    // 每次提交是否同步落盘 (PRAGMA synchronous = FULL / NORMAL)，默认 FULL。
+    // 由 RegJournal 负责持久性时可以关掉：WAL 模式下 NORMAL 仍保证崩溃后
+    // 数据库一致 (最近的事务可能丢失，由日志重放补回)，但提交时不再 fsync
+    void setSyncCommits(bool sync);
+
     // --- 接口: isUserRegistered ---
-    bool isUserRegistered(int id) override;
+    bool isUserRegistered(int64_t id) override;
 
     // --- 接口: saveUserPublicKey ---
-    void saveUserPublicKey(int id, const G1& pk) override;
+    void saveUserPublicKey(int64_t id, const G1& pk) override;
+    G1 getUserPublicKey(int64_t id) override;
 
     // --- 接口: getPPCommitment ---
-    G1 getPPCommitment(int block_index, int level) override;
+    G1 getPPCommitment(int64_t block_index, int level) override;
 
     // --- 接口: savePPCommitment ---
-    void savePPCommitment(int block_index, int level, const G1& com) override;
+    void savePPCommitment(int64_t block_index, int level,
+                          const G1& com) override;
 
     // --- 接口: deletePPCommitment ---
-    void deletePPCommitment(int block_index, int level) override;
+    void deletePPCommitment(int64_t block_index, int level) override;
 
     // --- 接口: getAuxUpdate ---
-    G1 getAuxUpdate(int row_id, int level) override;
+    G1 getAuxUpdate(int64_t row_id, int level) override;
 
     // --- 接口: saveAuxUpdate ---
-    void saveAuxUpdate(int row_id, int level, const G1& upd) override;
+    void saveAuxUpdate(int64_t row_id, int level, const G1& upd) override;
 
     // --- 接口: deleteAuxUpdate ---
-    void deleteAuxUpdate(int row_id, int level) override;
+    void deleteAuxUpdate(int64_t row_id, int level) override;
+
+    // --- 接口: getAuxVector ---
+    std::vector<G1> getAuxVector(int64_t block_index, int level) override;
+
+    // --- 接口: saveAuxVector ---
+    void saveAuxVector(int64_t block_index, int level,
+                       const std::vector<G1>& vec) override;
+
+    // --- 接口: deleteAuxVector ---
+    void deleteAuxVector(int64_t block_index, int level) override;
+    bool readAuxVector(int64_t block_index, int level,
+                       std::vector<G1>& out) override;
 
     // --- 接口: getUserCountInLevel ---
-    int getUserCountInLevel(int block_index, int level) override;
+    int64_t getUserCountInLevel(int64_t block_index, int level) override;
 
     // --- 接口: setUserCountInLevel ---
-    void setUserCountInLevel(int block_index, int level, int count) override;
+    void setUserCountInLevel(int64_t block_index, int level,
+                             int64_t count) override;
+
+    // --- 接口: getBlockUserCount ---
+    // 没有记录的块 (例如旧库) 按 counts 表里的层占用还原 (不含暂存层)
+    int64_t getBlockUserCount(int64_t block_index) override;
+
+    // --- 接口: setBlockUserCount ---
+    void setBlockUserCount(int64_t block_index, int64_t count) override;
 
     // --- 接口: hasAux ---
-    bool hasAux(int row_id, int level) override;
-};
\ No newline at end of file
+    bool hasAux(int64_t row_id, int level) override;
+
+    // --- 接口: 注册日志的检查点 (存在 meta 表里，随当前事务提交) ---
+    uint64_t getJournalCheckpoint() override;
+    void setJournalCheckpoint(uint64_t seq) override;
+    // meta 表里是否已经有检查点 (写过一次 setJournalCheckpoint)
+    bool hasJournalCheckpoint();
+
+    // --- 接口: 批处理 ---
+    // 最外层批次映射为一个 SQLite 事务 (BEGIN IMMEDIATE ... COMMIT)，
+    // 一次注册的整个合并级联、或调用方包起来的多次注册只同步一次日志。
+    void beginBatch() override;
+    void commitBatch() override;
+    void rollbackBatch() override;
+    bool batchFailed() const override { return batch_failed; }
+};
@@ -0,0 +1,169 @@
+#include <ShardedStorage.h>
+
+#include <algorithm>
+#include <cstdint>
+
+ShardedStorage::ShardedStorage(const std::string& path_prefix, int num_shards,
+                               int64_t n, int ser_mode)
+    : n(n) {
+    if (num_shards <= 0) {
+        std::cerr << "ShardedStorage needs at least one shard" << std::endl;
+        exit(1);
+    }
+    for (int i = 0; i < num_shards; ++i) {
+        std::string path = path_prefix + "_" + std::to_string(i) + ".db";
+        shards.emplace_back(new SQLiteStorage(path, ser_mode));
+    }
+    shard_in_batch.assign(num_shards, false);
+}
+
+Storage* ShardedStorage::route(int64_t block_index) {
+    int s = shardIndexOfBlock(block_index);
+    if (batch_depth > 0 && !shard_in_batch[s]) {
+        shards[s]->beginBatch();
+        shard_in_batch[s] = true;
+    }
+    return shards[s].get();
+}
+
+// --- 用户：按所在块路由 ---
+bool ShardedStorage::isUserRegistered(int64_t id) {
+    return route(id / n)->isUserRegistered(id);
+}
+
+void ShardedStorage::saveUserPublicKey(int64_t id, const G1& pk) {
+    route(id / n)->saveUserPublicKey(id, pk);
+}
+
+G1 ShardedStorage::getUserPublicKey(int64_t id) {
+    return route(id / n)->getUserPublicKey(id);
+}
+
+// --- PP ---
+G1 ShardedStorage::getPPCommitment(int64_t block_index, int level) {
+    return route(block_index)->getPPCommitment(block_index, level);
+}
+
+void ShardedStorage::savePPCommitment(int64_t block_index, int level,
+                                      const G1& com) {
+    route(block_index)->savePPCommitment(block_index, level, com);
+}
+
+void ShardedStorage::deletePPCommitment(int64_t block_index, int level) {
+    route(block_index)->deletePPCommitment(block_index, level);
+}
+
+// --- Aux 单行：按所在块路由 ---
+G1 ShardedStorage::getAuxUpdate(int64_t row_id, int level) {
+    return route(row_id / n)->getAuxUpdate(row_id, level);
+}
+
+void ShardedStorage::saveAuxUpdate(int64_t row_id, int level, const G1& upd) {
+    route(row_id / n)->saveAuxUpdate(row_id, level, upd);
+}
+
+void ShardedStorage::deleteAuxUpdate(int64_t row_id, int level) {
+    route(row_id / n)->deleteAuxUpdate(row_id, level);
+}
+
+// --- Aux 整向量 ---
+std::vector<G1> ShardedStorage::getAuxVector(int64_t block_index, int level) {
+    return route(block_index)->getAuxVector(block_index, level);
+}
+
+bool ShardedStorage::readAuxVector(int64_t block_index, int level,
+                                   std::vector<G1>& out) {
+    return route(block_index)->readAuxVector(block_index, level, out);
+}
+
+void ShardedStorage::saveAuxVector(int64_t block_index, int level,
+                                   const std::vector<G1>& vec) {
+    route(block_index)->saveAuxVector(block_index, level, vec);
+}
+
+void ShardedStorage::deleteAuxVector(int64_t block_index, int level) {
+    route(block_index)->deleteAuxVector(block_index, level);
+}
+
+// --- 计数器 ---
+int64_t ShardedStorage::getUserCountInLevel(int64_t block_index, int level) {
+    return route(block_index)->getUserCountInLevel(block_index, level);
+}
+
+void ShardedStorage::setUserCountInLevel(int64_t block_index, int level,
+                                         int64_t count) {
+    route(block_index)->setUserCountInLevel(block_index, level, count);
+}
+
+int64_t ShardedStorage::getBlockUserCount(int64_t block_index) {
+    return route(block_index)->getBlockUserCount(block_index);
+}
+
+void ShardedStorage::setBlockUserCount(int64_t block_index, int64_t count) {
+    route(block_index)->setBlockUserCount(block_index, count);
+}
+
+bool ShardedStorage::hasAux(int64_t row_id, int level) {
+    return route(row_id / n)->hasAux(row_id, level);
+}
+
+// --- 注册日志的检查点 ---
+uint64_t ShardedStorage::getJournalCheckpoint() {
+    uint64_t seq = UINT64_MAX;
+    bool found = false;
+    for (auto& shard : shards) {
+        if (sync_commits && !shard->hasJournalCheckpoint()) continue;
+        seq = std::min(seq, shard->getJournalCheckpoint());
+        found = true;
+    }
+    return found ? seq : 0;
+}
+
+void ShardedStorage::setJournalCheckpoint(uint64_t seq) {
+    // 第 s 块落在第 s 个分片上，route 顺便让分片加入当前批次
+    for (size_t s = 0; s < shards.size(); ++s) {
+        route((int64_t)s)->setJournalCheckpoint(seq);
+    }
+}
+
+// --- 批处理：只在被访问到的分片上开事务 ---
+void ShardedStorage::beginBatch() {
+    if (batch_depth++ == 0) batch_failed = false;
+}
+
+void ShardedStorage::commitBatch() {
+    if (batch_depth == 0) return;
+    if (--batch_depth > 0) return;
+    // 有分片的事务没能开始 (或已失败) 时整批回滚，不只提交其余分片
+    batch_failed = batchFailed();
+    for (size_t s = 0; s < shards.size(); ++s) {
+        if (!shard_in_batch[s]) continue;
+        if (batch_failed) {
+            shards[s]->rollbackBatch();
+        } else {
+            shards[s]->commitBatch();
+            // 前面的分片已经提交了 (不保证跨分片原子性)
+            if (shards[s]->batchFailed()) batch_failed = true;
+        }
+        shard_in_batch[s] = false;
+    }
+}
+
+bool ShardedStorage::batchFailed() const {
+    if (batch_failed) return true;
+    for (size_t s = 0; s < shards.size(); ++s) {
+        if (shard_in_batch[s] && shards[s]->batchFailed()) return true;
+    }
+    return false;
+}
+
+void ShardedStorage::rollbackBatch() {
+    if (batch_depth == 0) return;
+    batch_failed = true;
+    if (--batch_depth > 0) return;
+    for (size_t s = 0; s < shards.size(); ++s) {
+        if (!shard_in_batch[s]) continue;
+        shards[s]->rollbackBatch();
+        shard_in_batch[s] = false;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <SQLiteStorage.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// ---------------------------------------------------------
+// 按块分片的多文件 SQLite 后端。
+// 一个 SQLiteStorage 只有一个连接、一个数据库文件，所有块的注册都排在同一把
+// SQLite 写锁后面。这里把块 k 路由到第 k % K 个数据库文件，每个文件有自己
+// 独立的连接：
+//   - 用户 id、row_id 都按所在的块 (id / n) 路由，所以一次 reg() 涉及的
+//     公钥、承诺、计数、Aux 全部落在同一个分片上；
+//   - shardForBlock(k) 直接返回该分片，调用方可以在不同线程里对不同分片
+//     各自 reg()，各自提交，互不阻塞；
+//   - 每个文件只有总数据量的 1/K，更容易常驻页缓存。
+//
+// 通过 ShardedStorage 本身开启的批次只在真正被访问到的分片上开事务；
+// 跨分片的批次按分片逐个提交，不保证跨分片的原子性。
+// ---------------------------------------------------------
+class ShardedStorage : public Storage {
+    int64_t n;
+    std::vector<std::unique_ptr<SQLiteStorage>> shards;
+
+    // 批处理状态：哪些分片已经在当前批次里 beginBatch 过
+    int batch_depth = 0;
+    bool batch_failed = false;
+    std::vector<bool> shard_in_batch;
+    bool sync_commits = true;
+
+    int shardIndexOfBlock(int64_t block_index) const {
+        return (int)(block_index % (int64_t)shards.size());
+    }
+    // 取分片；批次进行中时，第一次访问某个分片会在该分片上开启事务
+    Storage* route(int64_t block_index);
+
+   public:
+    // 分片文件为 path_prefix + "_<i>.db"，i = 0 .. num_shards-1
+    // n: 块大小；ser_mode: 新建分片时使用的点编码 (见 SQLiteStorage)
+    ShardedStorage(const std::string& path_prefix, int num_shards, int64_t n,
+                   int ser_mode = SER_MODE);
+
+    int numShards() const { return shards.size(); }
+    // 对每个分片调用 SQLiteStorage::setSyncCommits
+    void setSyncCommits(bool sync) {
+        sync_commits = sync;
+        for (auto& shard : shards) shard->setSyncCommits(sync);
+    }
+    // 负责块 block_index 的分片，可以直接交给 reg() / enc() 使用
+    SQLiteStorage* shardForBlock(int64_t block_index) {
+        return shards[shardIndexOfBlock(block_index)].get();
+    }
+    Storage* storageForBlock(int64_t block_index) override {
+        return shardForBlock(block_index);
+    }
+
+    bool isUserRegistered(int64_t id) override;
+    void saveUserPublicKey(int64_t id, const G1& pk) override;
+    G1 getUserPublicKey(int64_t id) override;
+
+    G1 getPPCommitment(int64_t block_index, int level) override;
+    void savePPCommitment(int64_t block_index, int level,
+                          const G1& com) override;
+    void deletePPCommitment(int64_t block_index, int level) override;
+
+    G1 getAuxUpdate(int64_t row_id, int level) override;
+    void saveAuxUpdate(int64_t row_id, int level, const G1& upd) override;
+    void deleteAuxUpdate(int64_t row_id, int level) override;
+
+    std::vector<G1> getAuxVector(int64_t block_index, int level) override;
+    void saveAuxVector(int64_t block_index, int level,
+                       const std::vector<G1>& vec) override;
+    void deleteAuxVector(int64_t block_index, int level) override;
+    bool readAuxVector(int64_t block_index, int level,
+                       std::vector<G1>& out) override;
+
+    int64_t getUserCountInLevel(int64_t block_index, int level) override;
+    void setUserCountInLevel(int64_t block_index, int level,
+                             int64_t count) override;
+
+    int64_t getBlockUserCount(int64_t block_index) override;
+    void setBlockUserCount(int64_t block_index, int64_t count) override;
+
+    bool hasAux(int64_t row_id, int level) override;
+
+    // 检查点在每个分片里各存一份：写入时写进所有分片 (都加入当前批次)，
+    // 读出时取最小值。直接对单个分片注册 (ConcurrentRegistrar) 时只推进该
+    // 分片的检查点；从没写过检查点的分片上也没有应用过日志记录，不参与取
+    // 最小值。提交不同步 (setSyncCommits(false)) 时分片的第一个事务可能
+    // 丢失，这时仍按 0 计
+    uint64_t getJournalCheckpoint() override;
+    void setJournalCheckpoint(uint64_t seq) override;
+
+    void beginBatch() override;
+    void commitBatch() override;
+    void rollbackBatch() override;
+    bool batchFailed() const override;
+};
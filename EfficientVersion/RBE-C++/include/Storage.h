@@ -2,7 +2,8 @@
 #pragma once
 #include <RBE_Common.h>
 
-// 序列化模式：使用 mcl 的二进制序列化，节省空间
+// 序列化模式：默认使用 mcl 的压缩二进制序列化，节省空间
+// (可选 mcl::IoEcAffineSerialize，见 my_utils.h)
 const int SER_MODE = mcl::IoSerialize;
 
 class Storage {
@@ -11,30 +12,120 @@ class Storage {
 
     // --- 1. 用户 Key 相关 ---
     // 检查用户是否已注册
-    virtual bool isUserRegistered(int id) = 0;
+    virtual bool isUserRegistered(int64_t id) = 0;
     // 存储用户公钥 (模拟 Key Curator 收到 PK)
-    virtual void saveUserPublicKey(int id, const G1& pk) = 0;
+    virtual void saveUserPublicKey(int64_t id, const G1& pk) = 0;
+    // 读出用户公钥 (upd 用它判断用户在哪一层)，未注册时返回 0 (无穷远点)
+    virtual G1 getUserPublicKey(int64_t id) = 0;
 
     // --- PP 相关 (增加了 level 参数) ---
     // 获取某块、某层的承诺
-    virtual G1 getPPCommitment(int block_index, int level) = 0;
+    virtual G1 getPPCommitment(int64_t block_index, int level) = 0;
     // 存储
-    virtual void savePPCommitment(int block_index, int level,
+    virtual void savePPCommitment(int64_t block_index, int level,
                                   const G1& com) = 0;
     // 删除（合并后旧层级要清空）
-    virtual void deletePPCommitment(int block_index, int level) = 0;
+    virtual void deletePPCommitment(int64_t block_index, int level) = 0;
 
     // --- Aux 相关 (增加了 level 参数) ---
-    virtual G1 getAuxUpdate(int row_id, int level) = 0;
-    virtual void saveAuxUpdate(int row_id, int level, const G1& upd) = 0;
-    virtual void deleteAuxUpdate(int row_id, int level) = 0;
+    virtual G1 getAuxUpdate(int64_t row_id, int level) = 0;
+    virtual void saveAuxUpdate(int64_t row_id, int level, const G1& upd) = 0;
+    virtual void deleteAuxUpdate(int64_t row_id, int level) = 0;
+
+    // --- Aux 整向量 (某块、某层的全部 n 个位置，作为一条连续记录读写) ---
+    // 合并时一次搬运整个向量，避免 n 次单行读写；
+    // 该层不存在时 getAuxVector 返回空向量
+    virtual std::vector<G1> getAuxVector(int64_t block_index, int level) = 0;
+    virtual void saveAuxVector(int64_t block_index, int level,
+                               const std::vector<G1>& vec) = 0;
+    virtual void deleteAuxVector(int64_t block_index, int level) = 0;
+    // 把整条向量读进调用方的缓冲 out，复用 out 已有的容量 (合并路径上
+    // 不必每层分配一个新向量)。该层不存在时返回 false，out 的内容未定义。
+    // 默认实现经由 getAuxVector，各后端覆盖为直接解码 / 复制到 out
+    virtual bool readAuxVector(int64_t block_index, int level,
+                               std::vector<G1>& out) {
+        out = getAuxVector(block_index, level);
+        return !out.empty();
+    }
 
     // --- 计数器 (Helper) ---
     // 我们需要知道某个层级当前有没有东西，或者有多少人
     // 对应 Python 中的 pp_com_count 表
-    virtual int getUserCountInLevel(int block_index, int level) = 0;
-    virtual void setUserCountInLevel(int block_index, int level, int count) = 0;
+    virtual int64_t getUserCountInLevel(int64_t block_index, int level) = 0;
+    virtual void setUserCountInLevel(int64_t block_index, int level,
+                                     int64_t count) = 0;
+
+    // 块内已落座的用户总数 (不含延迟合并的暂存组)。各层占用情况恰好是
+    // 它的二进制表示 (第 j 层有人 <=> 第 j 位为 1)，reg() 据此直接算出
+    // 进位链，不必逐层探测 getUserCountInLevel
+    virtual int64_t getBlockUserCount(int64_t block_index) = 0;
+    virtual void setBlockUserCount(int64_t block_index, int64_t count) = 0;
 
     // 检查某行某层是否有Aux数据
-    virtual bool hasAux(int row_id, int level) = 0;
+    virtual bool hasAux(int64_t row_id, int level) = 0;
+
+    // --- 批处理 / 事务 ---
+    // begin 与 commit/rollback 成对出现，允许嵌套：只有最外层的 commit
+    // 才真正落盘，内层任意一次 rollback 会让整个最外层批次回滚。
+    // 默认实现为空操作，适用于没有事务概念的后端 (每次写入各自生效)。
+    virtual void beginBatch() {}
+    virtual void commitBatch() {}
+    virtual void rollbackBatch() {}
+    // 当前批次 (批次外时为刚结束的最外层批次) 是否失败：事务没能开始、
+    // 内层回滚过、或最后的提交没成功。失败的批次里的写入都不会生效，
+    // 调用方不能当作已经落盘 (见 StorageBatch::ok / commit)
+    virtual bool batchFailed() const { return false; }
+
+    // --- 注册日志的检查点 (见 RegJournal) ---
+    // 这个序号及之前的日志记录都已经应用到存储。和同一批次里的其他写入
+    // 一起提交，崩溃恢复时只重放它之后的记录。
+    // 默认不保存 (返回 0)，恢复时整份日志重放
+    virtual uint64_t getJournalCheckpoint() { return 0; }
+    virtual void setJournalCheckpoint(uint64_t /*seq*/) {}
+
+    // --- 并发 ---
+    // 返回 true 表示不同块上的调用可以在多个线程里同时进行
+    // (同一块上的调用仍要串行，见 ConcurrentRegistrar)。
+    // 默认 false：所有调用都必须串行。
+    virtual bool isConcurrencySafe() const { return false; }
+    // 负责块 block_index 的存储对象。分片后端返回对应的分片，
+    // 这样不同分片上的注册可以各自加锁、各自提交
+    virtual Storage* storageForBlock(int64_t /*block_index*/) { return this; }
+};
+
+// RAII 批处理守卫：构造时 beginBatch，析构时若未 commit 则 rollback。
+// 用法：
+//     StorageBatch batch(storage);
+//     if (!batch.ok()) ...  // 事务没能开始，不要写
+//     ... 若干写操作 ...
+//     if (!batch.commit()) ...  // 没有落盘
+class StorageBatch {
+    Storage* storage;
+    bool finished;
+
+   public:
+    explicit StorageBatch(Storage* s) : storage(s), finished(false) {
+        storage->beginBatch();
+    }
+    ~StorageBatch() {
+        if (!finished) storage->rollbackBatch();
+    }
+    StorageBatch(const StorageBatch&) = delete;
+    StorageBatch& operator=(const StorageBatch&) = delete;
+
+    // 批次还没有失败
+    bool ok() const { return !storage->batchFailed(); }
+    // 提交；返回 false 表示批次失败、写入没有生效
+    bool commit() {
+        if (!finished) {
+            finished = true;
+            storage->commitBatch();
+        }
+        return ok();
+    }
+    void rollback() {
+        if (finished) return;
+        finished = true;
+        storage->rollbackBatch();
+    }
 };
\ No newline at end of file
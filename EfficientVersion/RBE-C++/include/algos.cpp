@@ -1,8 +1,17 @@
 #include "algos.h"
 
+#include "FixedBase.h"
+#include "PairingTables.h"
+
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <thread>
 
-CRS setup(int N) {
+CRS setup(int64_t N) {
     CRS crs(N);
 
     // --- 修改开始 ---
@@ -20,18 +29,23 @@ CRS setup(int N) {
     z.setRand();
 
     // 3. 计算 h 参数 (保持之前的逻辑不变)
-    int limit = 2 * crs.n;
+    int64_t limit = 2 * crs.n;
     crs.h_g1.resize(limit + 1);
     crs.h_g2.resize(limit + 1);
+    // 下标 0 不用；mcl 的点默认不初始化，显式置 0 才能正常序列化
+    crs.h_g1[0].clear();
+    crs.h_g2[0].clear();
 
     Fr z_pow = z;  // 初始为 z^1
 
-    for (int i = 1; i <= limit; ++i) {
+    for (int64_t i = 1; i <= limit; ++i) {
         // 错误代码: if (i == crs.n) {
         // 修正为: 跳过 n+1
         if (i == crs.n + 1) {
             // h_{n+1} 是不需要的，因为它是 self-contribution 的基底
             // 保持 h_g1[i] 为 0
+            crs.h_g1[i].clear();
+            crs.h_g2[i].clear();
         } else {
             // h_g1[i] = g1 * z^i
             G1::mul(crs.h_g1[i], crs.g1, z_pow);
@@ -42,13 +56,78 @@ CRS setup(int N) {
         z_pow *= z;
     }
 
-    std::cout << "[Setup] CRS generated for N=" << N << ", n=" << crs.n
-              << std::endl;
+    // 全系统共用的 GT 常量 e(h_1, h_n) = e(g1, g2)^{z^{n+1}}
+    pairing(crs.e_zn1, crs.h_g1[1], crs.h_g2[crs.n]);
+
+    if (rbe_verbose)
+        std::cout << "[Setup] CRS generated for N=" << N << ", n=" << crs.n
+                  << std::endl;
     return crs;
 }
 
+// --- CRS 文件 ---
+static const char kCrsMagic[8] = {'R', 'B', 'E', 'C', 'R', 'S', '0', '1'};
+
+template <class T>
+static void write_elem(std::ofstream& out, const T& x) {
+    std::string s = x.getStr(mcl::IoSerialize);
+    uint32_t len = s.size();
+    out.write((const char*)&len, sizeof(len));
+    out.write(s.data(), len);
+}
+
+template <class T>
+static bool read_elem(std::ifstream& in, T& x) {
+    uint32_t len;
+    if (!in.read((char*)&len, sizeof(len)) || len > 4096) return false;
+    std::string s(len, '\0');
+    if (!in.read(&s[0], len)) return false;
+    return x.deserialize(s.data(), len, mcl::IoSerialize) == len;
+}
+
+bool save_crs(const CRS& crs, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Can't write CRS file: " << path << std::endl;
+        return false;
+    }
+    out.write(kCrsMagic, sizeof(kCrsMagic));
+    out.write((const char*)&crs.N, sizeof(crs.N));
+    write_elem(out, crs.g1);
+    write_elem(out, crs.g2);
+    for (const G1& p : crs.h_g1) write_elem(out, p);
+    for (const G2& p : crs.h_g2) write_elem(out, p);
+    write_elem(out, crs.e_zn1);
+    return (bool)out;
+}
+
+bool load_crs(const std::string& path, CRS& crs) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kCrsMagic)];
+    int64_t N;
+    if (!in || !in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kCrsMagic, sizeof(magic)) != 0 ||
+        !in.read((char*)&N, sizeof(N)) || N <= 0) {
+        std::cerr << "Bad CRS file: " << path << std::endl;
+        return false;
+    }
+    CRS loaded(N);
+    loaded.h_g1.resize(2 * loaded.n + 1);
+    loaded.h_g2.resize(2 * loaded.n + 1);
+    bool ok = read_elem(in, loaded.g1) && read_elem(in, loaded.g2);
+    for (G1& p : loaded.h_g1) ok = ok && read_elem(in, p);
+    for (G2& p : loaded.h_g2) ok = ok && read_elem(in, p);
+    ok = ok && read_elem(in, loaded.e_zn1);
+    if (!ok) {
+        std::cerr << "Bad CRS file: " << path << std::endl;
+        return false;
+    }
+    crs = std::move(loaded);
+    return true;
+}
+
 // id 是用户身份 (0 到 N-1)
-UserKeys gen(const CRS& crs, int id) {
+UserKeys gen(const CRS& crs, int64_t id) {
     UserKeys keys;
 
     // 1. 身份映射
@@ -58,14 +137,14 @@ UserKeys gen(const CRS& crs, int id) {
     // 但原文 setup 里 h 是从下标 1 开始填的，所以这里我们假设 C++ vector
     // 下标直接对应公式下标
 
-    int id_index = (id % crs.n) + 1;  // 调整为 1-based index 对应 h 列表
+    int64_t id_index = (id % crs.n) + 1;  // 调整为 1-based index 对应 h 列表
 
     // 2. 生成私钥 sk
     keys.sk.setRand();
 
     // 3. 计算公钥 pk = h_{id_index} ^ sk
     // mcl: G1::mul(out, point, scalar)
-    if (id_index >= crs.h_g1.size()) {
+    if (id_index >= (int64_t)crs.h_g1.size()) {
         std::cerr << "Error: id_index out of bounds" << std::endl;
         exit(1);
     }
@@ -77,12 +156,12 @@ UserKeys gen(const CRS& crs, int id) {
 
     keys.xi.resize(crs.n);
 
-    for (int j = 0; j < crs.n; j++) {
+    for (int64_t j = 0; j < crs.n; j++) {
         // Python逻辑: i = crs.n - 1 - j (倒序填充)
-        int i = crs.n - 1 - j;
+        int64_t i = crs.n - 1 - j;
 
         // 目标 h 的索引
-        int target_h_idx = (id % crs.n) + j +
+        int64_t target_h_idx = (id % crs.n) + j +
                            2;  // +1(因为id_index) + j + 1(公式) = id%n + j + 2
         // *注意*：这里一定要根据 Python 的 `id_index + j + 1` 仔细校对
         // Python id_index 是 0-based result of mod.
@@ -99,16 +178,18 @@ UserKeys gen(const CRS& crs, int id) {
         // + j + 2}
 
         // 修正后的 C++ 索引逻辑：
-        int python_list_idx = (id % crs.n) + j + 1;
+        int64_t python_list_idx = (id % crs.n) + j + 1;
 
         // 对应我们 C++ vector (如果此时 vector[1] 是 h_1):
         // 那么我们要取 vector[python_list_idx + 1]
-        int vec_idx = python_list_idx + 1;
+        int64_t vec_idx = python_list_idx + 1;
 
-        if (vec_idx >= crs.h_g1.size() ||
+        if (vec_idx >= (int64_t)crs.h_g1.size() ||
             vec_idx == crs.n + 1) {  // 也就是 h_{n+1}
             // Python: if h... == None: continue
-            // 对应 h_{n+1} 是空的
+            // 对应 h_{n+1} 是空的。这一位是用户自己的位置，置为 0 元，
+            // 不能留着未初始化的点 (解码时会被当成不合法的点拒绝)
+            keys.xi[i].clear();
             continue;
         }
 
@@ -119,6 +200,22 @@ UserKeys gen(const CRS& crs, int id) {
     return keys;
 }
 
+// 合并路径上的点缓冲：每个线程一组，扩容后一直复用，
+// 热路径上不再为每次注册、每个被吸收的层分配 / 释放长度为 n 的向量
+struct MergeBuffers {
+    std::vector<G1> acc;  // 正在累加的组的 Aux 向量
+    std::vector<G1> old;  // 读出来的旧层
+};
+static MergeBuffers& merge_buffers() {
+    thread_local MergeBuffers buffers;
+    return buffers;
+}
+
+// 注册的主体：current_aux_vec 进来时是新用户的 helping_values，
+// 直接在上面累加被吸收的层 (内容会被改掉)
+static void reg_into(const CRS& crs, Storage* storage, int64_t id,
+                     const G1& pk, std::vector<G1>& current_aux_vec);
+
 // 注册函数
 // 参数：
 // crs: 公共参考串
@@ -126,15 +223,37 @@ UserKeys gen(const CRS& crs, int id) {
 // id: 用户 ID
 // pk: 用户公钥
 // helping_values: 用户生成的辅助值列表 (xi)
-void reg(const CRS& crs, Storage* storage, int id, const G1& pk,
+void reg(const CRS& crs, Storage* storage, int64_t id, const G1& pk,
          const std::vector<G1>& helping_values) {
+    // 复制进本线程的缓冲 (复用已有容量)，不动调用方的向量
+    std::vector<G1>& aux = merge_buffers().acc;
+    aux.assign(helping_values.begin(), helping_values.end());
+    reg_into(crs, storage, id, pk, aux);
+}
+
+void reg(const CRS& crs, Storage* storage, int64_t id, const G1& pk,
+         std::vector<G1>&& helping_values) {
+    // 直接在调用方交出来的向量上累加，不复制
+    reg_into(crs, storage, id, pk, helping_values);
+}
+
+static void reg_into(const CRS& crs, Storage* storage, int64_t id,
+                     const G1& pk, std::vector<G1>& current_aux_vec) {
+    // 整个合并级联放在同一个批次里：要么全部落盘，要么全部不生效，
+    // 并且只同步一次日志。调用方可以在外面再包一层 StorageBatch，
+    // 把多次注册合并成一次提交 (批次允许嵌套)。
+    StorageBatch batch(storage);
+
     // 1. 基础检查与存储
-    if (storage->isUserRegistered(id)) return;
+    if (storage->isUserRegistered(id)) {
+        batch.commit();  // 不能 rollback，否则会连带回滚外层批次
+        return;
+    }
     storage->saveUserPublicKey(id, pk);
 
-    int n = crs.n;
-    int k = std::floor(id / n);  // 块号
-    int id_rel = id % n;         // 块内相对位置
+    int64_t n = crs.n;
+    int64_t k = id / n;  // 块号
+    int64_t id_rel = id % n;         // 块内相对位置
 
     // --- 准备初始数据 (Level -1) ---
     G1 current_com = pk;
@@ -144,91 +263,461 @@ void reg(const CRS& crs, Storage* storage, int id, const G1& pk,
     // 注意：用户不给自己提供 helping_value，所以 helping_values[id_rel] 应该是
     // 0 或无效值 这里的 current_aux_vec[i] 代表：当前这个(些)用户给位置 i
     // 的人的贡献总和
-    std::vector<G1> current_aux_vec = helping_values;
 
     // 确保自己给自己位置的贡献是 0 (虽然 gen 里面可能已经是了，为了安全起见)
     current_aux_vec[id_rel].clear();
 
-    int level = 0;
-
-    // --- 2048 风格合并循环 ---
-    while (true) {
-        // 1. 检查冲突
-        int count = storage->getUserCountInLevel(k, level);
-
-        if (count == 0) {
-            // --- 空位，落座 ---
-            // A. 存入 Commitment
-            storage->savePPCommitment(k, level, current_com);
-            storage->setUserCountInLevel(
-                k, level, 1);  // 这里 count 仅仅是个标记，设为 1 即可
-
-            // B. 存入 Aux 向量 (存入所有 n 个位置！)
-            // 无论这些位置上有没有人注册，都要存！因为这是为了未来合并准备的。
-            for (int i = 0; i < n; ++i) {
-                // 计算全局 row_id
-                int target_row = k * n + i;
-                storage->saveAuxUpdate(target_row, level, current_aux_vec[i]);
+    // --- 2048 风格合并：由块内用户数直接算出进位链 ---
+    // 块内第 j 层有人 <=> 用户数 c 的第 j 位为 1。新用户进来就是 c + 1：
+    // c 最低的连续若干个 1 (第 0 .. target-1 层) 全部进位，
+    // 和新用户一起落到第 target 层。所以只需读一次计数、读一遍被吸收的层、
+    // 写一次目标层，不用逐层探测、也不会把中间结果写下去再读回来。
+    int64_t c = storage->getBlockUserCount(k);
+    int target = 0;
+    while ((c >> target) & 1) target++;
+
+    for (int level = 0; level < target; ++level) {
+        if (rbe_verbose)
+            std::cout << "[Reg] Collision at Level " << level
+                      << ". Merging..." << std::endl;
+
+        // 读取被吸收的旧层，累加进当前组
+        G1 old_com = storage->getPPCommitment(k, level);
+        G1::add(current_com, current_com, old_com);
+
+        // Aux 向量对应位置相加 (Component-wise Addition)，整条向量一次读进
+        // 复用的缓冲；数据缺失时按 0 处理，和逐行读取时 getAuxUpdate 返回 0 一致
+        std::vector<G1>& old_aux_vec = merge_buffers().old;
+        if (storage->readAuxVector(k, level, old_aux_vec) &&
+            (int64_t)old_aux_vec.size() == n) {
+            for (int64_t i = 0; i < n; ++i) {
+                G1::add(current_aux_vec[i], current_aux_vec[i],
+                        old_aux_vec[i]);
+            }
+        }
+
+        // 清理旧层级
+        storage->deletePPCommitment(k, level);
+        storage->setUserCountInLevel(k, level, 0);
+        storage->deleteAuxVector(k, level);
+    }
+
+    // --- 落座 ---
+    // A. 存入 Commitment
+    storage->savePPCommitment(k, target, current_com);
+    storage->setUserCountInLevel(k, target,
+                                 1);  // 这里 count 仅仅是个标记，设为 1 即可
+
+    // B. 存入 Aux 向量 (存入所有 n 个位置！)
+    // 无论这些位置上有没有人注册，都要存！因为这是为了未来合并准备的。
+    // 整个向量作为一条记录写入，而不是 n 次单行写入
+    storage->saveAuxVector(k, target, current_aux_vec);
+    storage->setBlockUserCount(k, c + 1);
+
+    if (rbe_verbose)
+        std::cout << "[Reg] Settled at Block " << k << " Level " << target
+                  << std::endl;
+
+    batch.commit();
+}
+
+// 把块 k 的一组新用户 (按注册先后排列) 按二进制布局并入该块，
+// 不写用户公钥。算法见下面 reg_batch 的说明
+static void merge_into_block(const CRS& crs, Storage* storage, int64_t k,
+                             const std::vector<const RegRequest*>& group) {
+    int64_t n = crs.n;
+    G1 zero;
+    zero.clear();
+
+    // 1. 读出块内用户数 c，算出最终用户数 total
+    int64_t c = storage->getBlockUserCount(k);
+    int64_t total = c + (int64_t)group.size();
+    int p = 0;
+    while ((total >> p) != (c >> p)) p++;
+
+    // 2. 从高到低构造 p 以下的每个新层
+    size_t next = 0;  // group 中下一个要放置的用户
+    for (int lvl = p - 1; lvl >= 0; --lvl) {
+        if (((total >> lvl) & 1) == 0) continue;
+
+        G1 com = zero;
+        std::vector<G1>& aux_vec = merge_buffers().acc;
+        aux_vec.assign(n, zero);
+        int64_t slots = (int64_t)1 << lvl;
+
+        if (lvl == p - 1) {
+            // 吸收 p 以下所有旧层
+            for (int old = 0; old < p; ++old) {
+                if (((c >> old) & 1) == 0) continue;
+                G1::add(com, com, storage->getPPCommitment(k, old));
+                std::vector<G1>& old_aux = merge_buffers().old;
+                if (storage->readAuxVector(k, old, old_aux) &&
+                    (int64_t)old_aux.size() == n) {
+                    for (int64_t i = 0; i < n; ++i) {
+                        G1::add(aux_vec[i], aux_vec[i], old_aux[i]);
+                    }
+                }
+                slots -= (int64_t)1 << old;
+            }
+        }
+
+        for (; slots > 0; --slots, ++next) {
+            const RegRequest* r = group[next];
+            int64_t id_rel = r->id % n;
+            G1::add(com, com, r->pk);
+            for (int64_t i = 0; i < n; ++i) {
+                // 用户不给自己的位置贡献辅助值
+                if (i == id_rel) continue;
+                G1::add(aux_vec[i], aux_vec[i], r->xi[i]);
             }
+        }
 
-            std::cout << "[Reg] Settled at Block " << k << " Level " << level
+        storage->savePPCommitment(k, lvl, com);
+        storage->setUserCountInLevel(k, lvl, 1);
+        storage->saveAuxVector(k, lvl, aux_vec);
+
+        if (rbe_verbose)
+            std::cout << "[RegBatch] Block " << k << " Level " << lvl
+                      << " <- " << ((int64_t)1 << lvl) << " users"
                       << std::endl;
-            break;
+    }
+
+    // 3. 清理被吸收、且没有被新层覆盖的旧层
+    for (int old = 0; old < p; ++old) {
+        if (((c >> old) & 1) == 0 || ((total >> old) & 1) != 0) continue;
+        storage->deletePPCommitment(k, old);
+        storage->setUserCountInLevel(k, old, 0);
+        storage->deleteAuxVector(k, old);
+    }
+    storage->setBlockUserCount(k, total);
+}
+
+// 批量注册
+// 块内各层的占用情况恰好是块内用户数 c 的二进制表示 (第 j 层有 2^j 个人)。
+// 再注册 m 个人后占用情况就是 c + m 的二进制表示：
+//   - 设 p 为最低的、满足 (c + m) >> p == c >> p 的层，p 及以上的层原样保留；
+//   - p 以下旧的层全部被吸收，进入新的最高层 p - 1 (c + m 的第 p-1 位一定是 1)；
+//   - 合并总是把较新的组并进较旧的组，所以各层按层号从高到低恰好是
+//     按注册先后排列：最高的新层先装被吸收的旧层，再装最早的新用户，
+//     剩下的新用户依次填入更低的层。
+// 因此每个新用户只累加进一个最终层，每个旧层只读一次，每个新层只写一次。
+void reg_batch(const CRS& crs, Storage* storage,
+               const std::vector<RegRequest>& requests) {
+    StorageBatch batch(storage);
+
+    int64_t n = crs.n;
+
+    // 1. 过滤已注册 / 批内重复的 id，按块分组 (块内保持提交顺序)
+    std::map<int64_t, std::vector<const RegRequest*>> by_block;
+    std::set<int64_t> seen;
+    for (const RegRequest& r : requests) {
+        if (!seen.insert(r.id).second || storage->isUserRegistered(r.id)) {
+            continue;
         }
+        by_block[r.id / n].push_back(&r);
+    }
 
-        // --- 冲突，合并 ---
-        std::cout << "[Reg] Collision at Level " << level << ". Merging..."
-                  << std::endl;
+    for (const auto& entry : by_block) {
+        int64_t k = entry.first;
+        const std::vector<const RegRequest*>& group = entry.second;
 
-        // 2. 获取旧数据 (Old Group)
-        G1 old_com = storage->getPPCommitment(k, level);
+        for (const RegRequest* r : group) {
+            storage->saveUserPublicKey(r->id, r->pk);
+        }
+
+        merge_into_block(crs, storage, k, group);
+    }
 
-        // 读取旧的 Aux 向量 (全部 n 个)
-        std::vector<G1> old_aux_vec(n);
-        for (int i = 0; i < n; ++i) {
-            int target_row = k * n + i;
-            // 必须保证 hasAux 为真，或者 getAuxUpdate 返回 0
-            old_aux_vec[i] = storage->getAuxUpdate(target_row, level);
+    batch.commit();
+}
+
+// --- 辅助值校验 ---
+// 请求数少于这个值时在 G2 一侧聚合：每条请求一次长度为 n 的 G2 mulVec，
+// 配对 m+1 对；请求多时在 G1 一侧按 h_{n-i} 聚合公钥：n 次长度为 m 的
+// G1 mulVec，配对固定 n+1 对
+static const size_t kVerifyG1SideMin = 16;
+// 一组最多这么多条请求 (随机系数要 m*n 个 Fr)
+static const size_t kVerifyMaxGroup = 256;
+
+// 整组请求合成一个等式检查，见 algos.h 中 verify_helping_values 的说明。
+// 对所有 u、i 取随机系数 r_{u,i} (自己的位置为 0)，检查
+//     e(sum_u sum_i r_{u,i} xi_u[i], g2) * prod_u prod_i e(-pk_u, h_{n-i})^{r_{u,i}} == 1
+static bool verify_group(const CRS& crs,
+                         const std::vector<const RegRequest*>& group) {
+    int64_t n = crs.n;
+    size_t m = group.size();
+
+    std::vector<Fr> r(m * n);
+    for (size_t u = 0; u < m; ++u) {
+        int64_t a = group[u]->id % n;
+        for (int64_t i = 0; i < n; ++i) {
+            if (i == a) {
+                r[u * n + i].clear();
+            } else {
+                r[u * n + i].setByCSPRNG();
+            }
         }
+    }
 
-        // 3. 执行合并 (Merge)
-        // Commitment 相加
-        G1::add(current_com, current_com, old_com);
+    // mulVec 可能改写输入的点 (就地归一化)，都先复制一份
+    std::vector<G1> buf(std::max<size_t>(n, m));
+    std::vector<G1> P;
+    std::vector<G2> Q;
+
+    // 左边：X = sum_u sum_i r_{u,i} * xi_u[i]
+    G1 X, t;
+    X.clear();
+    for (size_t u = 0; u < m; ++u) {
+        std::copy(group[u]->xi.begin(), group[u]->xi.end(), buf.begin());
+        G1::mulVec(t, buf.data(), &r[u * n], n);
+        G1::add(X, X, t);
+    }
+    P.push_back(X);
+    Q.push_back(crs.g2);
+
+    if (m < kVerifyG1SideMin) {
+        // 每条请求一对 e(-pk_u, Z_u)，Z_u = sum_i r_{u,i} * h_{n-i}
+        std::vector<G2> h(n);
+        for (size_t u = 0; u < m; ++u) {
+            for (int64_t i = 0; i < n; ++i) h[i] = crs.h_g2[n - i];
+            G2 Z;
+            G2::mulVec(Z, h.data(), &r[u * n], n);
+            G1 neg_pk;
+            G1::neg(neg_pk, group[u]->pk);
+            P.push_back(neg_pk);
+            Q.push_back(Z);
+        }
+    } else {
+        // 每个位置 i 一对 e(-Y_i, h_{n-i})，Y_i = sum_u r_{u,i} * pk_u
+        std::vector<Fr> c(m);
+        for (int64_t i = 0; i < n; ++i) {
+            for (size_t u = 0; u < m; ++u) {
+                buf[u] = group[u]->pk;
+                c[u] = r[u * n + i];
+            }
+            G1 Y;
+            G1::mulVec(Y, buf.data(), c.data(), m);
+            G1::neg(Y, Y);
+            P.push_back(Y);
+            Q.push_back(crs.h_g2[n - i]);
+        }
+    }
+
+    GT f;
+    millerLoopVec(f, P.data(), Q.data(), P.size());
+    finalExp(f, f);
+    return f.isOne();
+}
 
-        // Aux 向量对应位置相加 (Component-wise Addition)
-        for (int i = 0; i < n; ++i) {
-            G1::add(current_aux_vec[i], current_aux_vec[i], old_aux_vec[i]);
+// 整组没通过时对半拆开重查，直到找出不合法的请求
+static void verify_bisect(const CRS& crs,
+                          const std::vector<RegRequest>& requests,
+                          const std::vector<size_t>& idx,
+                          std::vector<bool>& ok) {
+    if (idx.empty()) return;
+    std::vector<const RegRequest*> group;
+    for (size_t i : idx) group.push_back(&requests[i]);
+    if (verify_group(crs, group)) {
+        for (size_t i : idx) ok[i] = true;
+        return;
+    }
+    if (idx.size() == 1) return;
+    size_t half = idx.size() / 2;
+    verify_bisect(crs, requests,
+                  std::vector<size_t>(idx.begin(), idx.begin() + half), ok);
+    verify_bisect(crs, requests,
+                  std::vector<size_t>(idx.begin() + half, idx.end()), ok);
+}
+
+std::vector<bool> verify_reg_batch(const CRS& crs,
+                                   const std::vector<RegRequest>& requests) {
+    std::vector<bool> ok(requests.size(), false);
+    std::vector<size_t> idx;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const RegRequest& r = requests[i];
+        // 形状不对的请求直接拒绝，不进入合成的等式
+        if (r.id < 0 || r.id >= crs.N || (int64_t)r.xi.size() != crs.n) {
+            continue;
         }
+        idx.push_back(i);
+        if (idx.size() == kVerifyMaxGroup) {
+            verify_bisect(crs, requests, idx, ok);
+            idx.clear();
+        }
+    }
+    verify_bisect(crs, requests, idx, ok);
+    return ok;
+}
 
-        // 4. 清理旧层级
-        storage->deletePPCommitment(k, level);
-        storage->setUserCountInLevel(k, level, 0);
-        // 删除旧层级的所有 Aux 数据
-        for (int i = 0; i < n; ++i) {
-            int target_row = k * n + i;
-            storage->deleteAuxUpdate(target_row, level);
+bool verify_helping_values(const CRS& crs, int64_t id, const G1& pk,
+                           const std::vector<G1>& helping_values) {
+    return verify_reg_batch(crs, {{id, pk, helping_values}})[0];
+}
+
+// 块 k 前 max_groups 个暂存层里第一个空的，都占满时返回 -1
+static int free_pending_level(const CRS& crs, Storage* storage, int64_t k,
+                              int max_groups) {
+    int first = rbe_pending_level(crs.n);
+    for (int s = 0; s < max_groups; ++s) {
+        if (storage->getUserCountInLevel(k, first + s) == 0) return first + s;
+    }
+    return -1;
+}
+
+// 延迟合并：新用户单独成组写进空暂存层，不做合并级联
+int64_t reg_deferred(const CRS& crs, Storage* storage, int64_t id,
+                     const G1& pk, const std::vector<G1>& helping_values,
+                     int max_groups) {
+    // 长度不对的辅助值不能拿来当组的 Aux 向量，在写任何东西之前拒绝
+    if (id < 0 || id >= crs.N ||
+        (int64_t)helping_values.size() != crs.n) {
+        std::cerr << "[RegDeferred] Rejected id " << id << ": "
+                  << helping_values.size() << " helping values, expected "
+                  << crs.n << std::endl;
+        return 0;
+    }
+
+    StorageBatch batch(storage);
+
+    if (storage->isUserRegistered(id)) {
+        batch.commit();  // 不能 rollback，否则会连带回滚外层批次
+        return 0;
+    }
+
+    int64_t n = crs.n;
+    int64_t k = id / n;
+    int64_t id_rel = id % n;
+    max_groups = std::max(1, std::min(max_groups, kRbePendingGroups));
+
+    // 暂存组按注册先后占用 first, first + 1, ...，合并时整体清空
+    int lvl = free_pending_level(crs, storage, k, max_groups);
+    if (lvl < 0) {
+        compact_pending(crs, storage, k);
+        lvl = free_pending_level(crs, storage, k, max_groups);
+    }
+    if (lvl < 0) {
+        // 暂存组损坏、合并不掉：退回同步合并
+        reg(crs, storage, id, pk, helping_values);
+        batch.commit();
+        return pending_groups(crs, storage, k);
+    }
+
+    storage->saveUserPublicKey(id, pk);
+
+    // 单人组：承诺是 pk，Aux 向量是辅助值 (用户不给自己的位置贡献辅助值)
+    std::vector<G1>& aux_vec = merge_buffers().acc;
+    aux_vec.assign(helping_values.begin(), helping_values.begin() + n);
+    aux_vec[id_rel].clear();
+
+    storage->savePPCommitment(k, lvl, pk);
+    storage->saveAuxVector(k, lvl, aux_vec);
+    storage->setUserCountInLevel(k, lvl, id_rel + 1);
+
+    int64_t used = pending_groups(crs, storage, k);
+    if (rbe_verbose)
+        std::cout << "[RegDeferred] Block " << k << " pending " << used
+                  << std::endl;
+
+    if (!batch.commit()) return 0;
+    return used;
+}
+
+int64_t pending_groups(const CRS& crs, Storage* storage, int64_t k) {
+    int first = rbe_pending_level(crs.n);
+    int64_t used = 0;
+    for (int s = 0; s < kRbePendingGroups; ++s) {
+        if (storage->getUserCountInLevel(k, first + s) != 0) used++;
+    }
+    return used;
+}
+
+// 合并暂存组：从存储里还原各组的用户，按二进制布局并入块 k
+int64_t compact_pending(const CRS& crs, Storage* storage, int64_t k) {
+    int64_t n = crs.n;
+    int first = rbe_pending_level(n);
+
+    StorageBatch batch(storage);
+    std::vector<RegRequest> users;
+    std::vector<int> levels;
+    for (int s = 0; s < kRbePendingGroups; ++s) {
+        int lvl = first + s;
+        int64_t tag = storage->getUserCountInLevel(k, lvl);
+        if (tag == 0) continue;
+        RegRequest r;
+        r.id = k * n + tag - 1;
+        r.pk = storage->getPPCommitment(k, lvl);
+        if (!storage->readAuxVector(k, lvl, r.xi) ||
+            (int64_t)r.xi.size() != n) {
+            std::cerr << "[Compact] Block " << k << " pending level " << lvl
+                      << " has no aux vector, skipped" << std::endl;
+            continue;
         }
+        users.push_back(std::move(r));
+        levels.push_back(lvl);
+    }
+    if (users.empty()) {
+        batch.commit();
+        return 0;
+    }
 
-        // 5. 晋升
-        level++;
+    std::vector<const RegRequest*> group;
+    for (const RegRequest& r : users) group.push_back(&r);
+    merge_into_block(crs, storage, k, group);
+
+    for (int lvl : levels) {
+        storage->deletePPCommitment(k, lvl);
+        storage->setUserCountInLevel(k, lvl, 0);
+        storage->deleteAuxVector(k, lvl);
     }
+
+    if (rbe_verbose)
+        std::cout << "[Compact] Block " << k << " merged " << users.size()
+                  << " users" << std::endl;
+
+    if (!batch.commit()) return 0;
+    return (int64_t)users.size();
+}
+
+// 一层的密文分量：com 是该层的 commitment (非 0)，h_idx_g2 = n - id % n
+static void enc_component(const CRS& crs, const G1& com, int lvl,
+                          int64_t h_idx_g2, const GT& message,
+                          CiphertextComponent& comp) {
+    comp.level = lvl;
+    comp.ct0 = com;
+
+    Fr r;
+    r.setRand();
+
+    // ct1 = e(com, h_term)^r = e(r * com, h_term)：指数放到 G1 一侧，
+    // G1 标量乘比 GT 上的幂运算便宜得多，h_term 一侧还能用系数表
+    G1 com_r;
+    G1::mul(com_r, com, r);
+    crs_miller_loop_h(crs, comp.ct1, com_r, h_idx_g2);
+    finalExp(comp.ct1, comp.ct1);
+
+    // ct2 = g2^r
+    crs_mul_g2(crs, comp.ct2, r);
+
+    // ct3 = e(h_id, h_term)^r * m，e(h_id, h_term) 就是 CRS 里的常量
+    GT e_val_r;
+    crs_pow_e_zn1(crs, e_val_r, r);
+    GT::mul(comp.ct3, e_val_r, message);
 }
 
 // 加密函数
 // message: 这里假设消息 m 本身就是 GT 上的一个元素 (为了简化)
-Ciphertext enc(const CRS& crs, Storage* storage, int id, const GT& message) {
+Ciphertext enc(const CRS& crs, Storage* storage, int64_t id,
+               const GT& message) {
     Ciphertext final_ct;
-    int n = crs.n;
-    int k = std::floor(id / n);
-    int id_index = id % n;
+    int64_t n = crs.n;
+    int64_t k = id / n;
+    int64_t id_index = id % n;
 
     // 辅助参数准备
-    int h_idx_g2 = n - id_index;
-    const G2& h_term_g2 = crs.h_g2[h_idx_g2];
-    const G1& h_id_g1 = crs.h_g1[id_index + 1];
+    int64_t h_idx_g2 = n - id_index;
 
     // 遍历所有可能的层级
-    int max_level = std::ceil(std::log2(n)) + 2;
+    int max_level = rbe_max_level(n);
 
     for (int lvl = 0; lvl <= max_level; ++lvl) {
         // 1. 获取该层的 Commitment
@@ -239,25 +728,7 @@ Ciphertext enc(const CRS& crs, Storage* storage, int id, const GT& message) {
 
         // 2. 针对这一层进行加密 (和 Base RBE 逻辑一样)
         CiphertextComponent comp;
-        comp.level = lvl;
-        comp.ct0 = com;
-
-        Fr r;
-        r.setRand();
-
-        // ct1 = e(com, h_term)^r
-        GT pair_val;
-        mcl::bn::pairing(pair_val, com, h_term_g2);
-        GT::pow(comp.ct1, pair_val, r);
-
-        // ct2 = g2^r
-        G2::mul(comp.ct2, crs.g2, r);
-
-        // ct3 = e(h_id, h_term)^r * m
-        GT e_val, e_val_r;
-        mcl::bn::pairing(e_val, h_id_g1, h_term_g2);
-        GT::pow(e_val_r, e_val, r);
-        GT::mul(comp.ct3, e_val_r, message);
+        enc_component(crs, com, lvl, h_idx_g2, message, comp);
 
         // 加入列表
         final_ct.components.push_back(comp);
@@ -266,27 +737,100 @@ Ciphertext enc(const CRS& crs, Storage* storage, int id, const GT& message) {
     return final_ct;
 }
 
-std::pair<int, G1> upd(const CRS& crs, Storage* storage, int id) {
-    // 我们的 Storage 没有直接提供 "find level by id" 的接口。
-    // 但我们可以遍历 Level 0 到 log N。对于 N=100，最多也就 7 层，很快。
+std::vector<Ciphertext> enc_batch(const CRS& crs, Storage* storage,
+                                  const std::vector<EncRequest>& requests,
+                                  int num_threads) {
+    if (num_threads < 1) num_threads = 1;
+    int64_t n = crs.n;
+    int max_level = rbe_max_level(n);
+
+    // 1. 按块取 commitment，每块只读一次；存储只在当前线程访问
+    std::map<int64_t, std::vector<std::pair<int, G1>>> block_coms;
+    for (const EncRequest& req : requests) {
+        int64_t k = req.id / n;
+        if (block_coms.count(k)) continue;
+        std::vector<std::pair<int, G1>>& coms = block_coms[k];
+        for (int lvl = 0; lvl <= max_level; ++lvl) {
+            G1 com = storage->getPPCommitment(k, lvl);
+            if (!com.isZero()) coms.emplace_back(lvl, com);
+        }
+    }
+
+    // 2. 各线程从同一个计数器领取下一个接收者，结果按输入顺序存放
+    std::vector<Ciphertext> out(requests.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < requests.size(); i = next++) {
+            const EncRequest& req = requests[i];
+            const auto& coms = block_coms.find(req.id / n)->second;
+            int64_t h_idx_g2 = n - req.id % n;
+            out[i].components.resize(coms.size());
+            for (size_t c = 0; c < coms.size(); ++c) {
+                enc_component(crs, coms[c].second, coms[c].first, h_idx_g2,
+                              req.message, out[i].components[c]);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; ++t) threads.emplace_back(worker);
+    worker();  // 当前线程也干活
+    for (std::thread& t : threads) t.join();
+    return out;
+}
+
+// 用户 a = id % n 是否在 (com, aux) 这个组里：组里其他人 j 的辅助值满足
+// e(xi_j[a], g2) == e(pk_j, h_{n-a})，所以用户在组里当且仅当
+// e(com - pk, h_{n-a}) == e(aux[a], g2)。一次双配对 (CRS 有表时用表)
+static bool group_contains(const CRS& crs, const G1& com, const G1& pk,
+                           const G1& aux, int64_t id_rel) {
+    G1 others, neg_aux;
+    G1::sub(others, com, pk);
+    G1::neg(neg_aux, aux);
+    GT f;
+    crs_miller_loop_h_g2(crs, f, others, crs.n - id_rel, neg_aux);
+    finalExp(f, f);
+    return f.isOne();
+}
 
-    int k = std::floor(id / crs.n);
-    int max_level = std::ceil(std::log2(crs.n)) + 2;  // 稍微多扫几层防万一
+std::pair<int, G1> upd(const CRS& crs, Storage* storage, int64_t id) {
+    // Aux 按 (块, 层) 整向量存放，块里每个有人的层对所有位置都有 aux，
+    // 要找的是用户自己所在的那一层：
+    //   - 暂存层的计数就是 id % n + 1 (见 reg_deferred)，直接比对；
+    //   - 普通层的计数只是占用标记，用 group_contains 逐层检查，
+    //     最后一个候选层不用检查 (用户已注册又不在暂存层，只能在那里)。
+    int64_t n = crs.n;
+    int64_t k = id / n;
+    int64_t id_rel = id % n;
+    G1 zero;
+    zero.clear();
+    if (!storage->isUserRegistered(id)) return {-1, zero};
 
-    for (int lvl = 0; lvl <= max_level; ++lvl) {
-        if (storage->hasAux(id, lvl)) {
-            // 找到了！用户在这一层
+    int first = rbe_pending_level(n);
+    for (int lvl = first; lvl <= rbe_max_level(n); ++lvl) {
+        if (storage->getUserCountInLevel(k, lvl) == id_rel + 1) {
             return {lvl, storage->getAuxUpdate(id, lvl)};
         }
     }
 
-    // 没找到
-    G1 zero;
-    zero.clear();
-    return {-1, zero};
+    std::vector<int> levels;
+    for (int lvl = 0; lvl < first; ++lvl) {
+        if (storage->getUserCountInLevel(k, lvl) != 0) levels.push_back(lvl);
+    }
+    if (levels.empty()) return {-1, zero};  // 数据丢了
+
+    G1 pk = storage->getUserPublicKey(id);
+    for (size_t i = 0; i + 1 < levels.size(); ++i) {
+        G1 aux = storage->getAuxUpdate(id, levels[i]);
+        if (group_contains(crs, storage->getPPCommitment(k, levels[i]), pk,
+                           aux, id_rel)) {
+            return {levels[i], aux};
+        }
+    }
+    return {levels.back(), storage->getAuxUpdate(id, levels.back())};
 }
 
-DecResult dec(const CRS& crs, int id, const Fr& sk,
+DecResult dec(const CRS& crs, int64_t id, const Fr& sk,
               const std::pair<int, G1>& user_upd_info, const Ciphertext& ct) {
     DecResult res;
 
@@ -321,22 +865,20 @@ DecResult dec(const CRS& crs, int id, const Fr& sk,
     // 2. 使用 Base RBE 的逻辑解密 target_comp
     // ... 代码逻辑和之前完全一样，只是把 ct.ct0 换成 target_comp->ct0 等等 ...
 
-    int n = crs.n;
-    int id_index = id % n;
-    int h_idx_g2 = n - id_index;
-    const G2& h_term_g2 = crs.h_g2[h_idx_g2];
-
-    // 验证公式
-    GT lhs;
-    mcl::bn::pairing(lhs, target_comp->ct0, h_term_g2);
-
-    G1 my_pk;
-    G1::mul(my_pk, crs.h_g1[id_index + 1], sk);
-
-    GT rhs_part1, rhs_part2, rhs;
-    mcl::bn::pairing(rhs_part1, my_aux, crs.g2);
-    mcl::bn::pairing(rhs_part2, my_pk, h_term_g2);
-    GT::mul(rhs, rhs_part1, rhs_part2);
+    int64_t n = crs.n;
+    int64_t id_index = id % n;
+    int64_t h_idx_g2 = n - id_index;
+
+    // 验证公式 e(ct0, h_term) = e(my_aux, g2) * e(my_pk, h_term)
+    // my_pk = h_{id+1}^sk，所以 e(my_pk, h_term) = e_zn1^sk，不用配对；
+    // 左边两个配对移到一起，共用一次 Miller loop 和 finalExp:
+    // e(ct0, h_term) * e(-my_aux, g2) = e_zn1^sk
+    GT lhs, rhs;
+    G1 neg_aux;
+    G1::neg(neg_aux, my_aux);
+    crs_miller_loop_h_g2(crs, lhs, target_comp->ct0, h_idx_g2, neg_aux);
+    finalExp(lhs, lhs);
+    GT::pow(rhs, crs.e_zn1, sk);
 
     if (lhs != rhs) {
         res.success = false;
@@ -1,21 +1,101 @@
 #pragma once
 #include <map>
 #include <set>
+#include <string>
 
 #include "RBE_Common.h"
 #include "Storage.h"
 
-CRS setup(int N);
+CRS setup(int64_t N);
+
+// CRS 存成二进制文件 / 从文件读回 (含 GT 常量 e_zn1，读回后不必重新配对)。
+// 文件格式：magic "RBECRS01" | N i64 | 之后每个元素 len u32 + mcl 序列化
+//          (g1, g2, h_g1[0..2n], h_g2[0..2n], e_zn1)
+// 失败时打印原因并返回 false
+bool save_crs(const CRS& crs, const std::string& path);
+bool load_crs(const std::string& path, CRS& crs);
 
 // id 是用户身份 (0 到 N-1)
-UserKeys gen(const CRS& crs, int id);
+UserKeys gen(const CRS& crs, int64_t id);
 
-void reg(const CRS& crs, Storage* storage, int id, const G1& pk,
+void reg(const CRS& crs, Storage* storage, int64_t id, const G1& pk,
          const std::vector<G1>& helping_values);
+// 同上，但接管 helping_values：合并直接在这个向量上累加，省掉一次复制
+// (调用后它的内容不再是原来的辅助值)
+void reg(const CRS& crs, Storage* storage, int64_t id, const G1& pk,
+         std::vector<G1>&& helping_values);
+
+// 一条待注册记录 (reg 的参数打包)
+struct RegRequest {
+    int64_t id;
+    G1 pk;
+    std::vector<G1> xi;  // 用户生成的辅助值 (helping_values)
+};
+
+// --- 辅助值校验 (可选，注册前调用) ---
+// 设 a = id % n。合法的辅助值满足 pk = h_{a+1}^sk、xi[i] = h_{a+1+n-i}^sk
+// (i != a，xi[a] 是用户自己的位置，不参与)，即 e(xi[i], g2) == e(pk, h_{n-i})。
+// 逐个检查要 2n 次配对；这里取随机系数 r_i，只检查一个组合等式
+//     e(sum r_i * xi[i], g2) == prod e(pk, h_{n-i})^{r_i}
+// 用 mulVec 把点聚合起来，再做一次 millerLoopVec + finalExp。
+// 随机系数取自整个 Fr，不合法的请求被放过的概率约为 1/r。
+// xi 的点本身必须已经在 G1 的子群里 (解码时检查，见 g1vec_decode)。
+bool verify_helping_values(const CRS& crs, int64_t id, const G1& pk,
+                           const std::vector<G1>& helping_values);
+
+// 一次校验很多条请求 (所有请求的等式再用随机系数合成一个)，
+// 返回每条请求是否通过。整批没通过时对半拆开重查，找出不合法的请求。
+std::vector<bool> verify_reg_batch(const CRS& crs,
+                                   const std::vector<RegRequest>& requests);
+
+// 批量注册：结果与按顺序逐个调用 reg 相同 (已注册的、批内重复的 id 跳过)，
+// 但按块分组，在内存里算出每个块最终的层布局后一次写入，
+// 而不是每个用户各走一遍合并级联。整个批次在同一个 StorageBatch 里提交。
+void reg_batch(const CRS& crs, Storage* storage,
+               const std::vector<RegRequest>& requests);
+
+// 延迟合并模式 (LSM 风格，调度见 ConcurrentRegistrar)：
+// reg_deferred 把新用户单独写成一个未合并的组，放进块的第一个空暂存层
+// (rbe_pending_level(n) 起的 max_groups 层，最多 kRbePendingGroups)，
+// 代价固定为一次写入，不做合并级联。组的承诺就是 pk，Aux 向量就是该用户的
+// 辅助值，是一个合法的组，enc / upd 照常扫描到它；组的计数记 id % n + 1，
+// 合并时据此还原用户。暂存层都满了时先 compact_pending 腾出位置 (反压)。
+// 返回写入后块内未合并的组数。id 已注册、id 越界或辅助值不是 n 个时
+// 返回 0，什么也不做；存储的批次失败时也返回 0 (见 Storage::batchFailed)。
+int64_t reg_deferred(const CRS& crs, Storage* storage, int64_t id,
+                     const G1& pk, const std::vector<G1>& helping_values,
+                     int max_groups = kRbePendingGroups);
+
+// 块 k 还有多少个未合并的组
+int64_t pending_groups(const CRS& crs, Storage* storage, int64_t k);
+
+// 从存储里读出块 k 所有未合并的组 (按注册先后)，按二进制布局并入各层，
+// 再删掉这些暂存层；返回合并的人数 (批次失败时为 0)。输入全部来自存储，进程崩溃重启后
+// 照样可以合并
+int64_t compact_pending(const CRS& crs, Storage* storage, int64_t k);
+
+Ciphertext enc(const CRS& crs, Storage* storage, int64_t id,
+               const GT& message);
+
+// 一条待加密的消息 (enc 的参数打包)
+struct EncRequest {
+    int64_t id;
+    GT message;
+};
 
-Ciphertext enc(const CRS& crs, Storage* storage, int id, const GT& message);
+// 批量加密，结果按输入顺序返回，与逐个 enc 相同。
+// 每块的 commitment 只从存储读一次 (存储只在调用线程里访问)，
+// 各分量的计算分给 num_threads 个线程 (含调用线程)。
+// 不会自己建表：CRS 的系数表 / 固定底数表要在 setup / load_crs 之后开启
+// 一次 (crs_enable_precompute / crs_enable_fixed_base)，之后所有调用共用。
+std::vector<Ciphertext> enc_batch(const CRS& crs, Storage* storage,
+                                  const std::vector<EncRequest>& requests,
+                                  int num_threads);
 
-std::pair<int, G1> upd(const CRS& crs, Storage* storage, int id);
+// 返回用户所在的层和该层 Aux 向量里用户位置上的值 (解密用)，
+// 用户未注册时层号为 -1。按层存放的数据里看不出组里有谁，除暂存层外
+// 每个候选层要做一次配对检查 (见 algos.cpp)
+std::pair<int, G1> upd(const CRS& crs, Storage* storage, int64_t id);
 
 // 解密结果结构体
 struct DecResult {
@@ -24,5 +104,5 @@ struct DecResult {
     GT message;        // 解密出的消息
 };
 
-DecResult dec(const CRS& crs, int id, const Fr& sk,
+DecResult dec(const CRS& crs, int64_t id, const Fr& sk,
               const std::pair<int, G1>& user_upd_info, const Ciphertext& ct);
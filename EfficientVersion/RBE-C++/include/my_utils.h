@@ -1,21 +1,134 @@
 #pragma once
 #include <RBE_Common.h>
 
+#include <algorithm>
+
+// 序列化模式 (mode 参数) 可选：
+//   mcl::IoSerialize         压缩形式，只存 x 和 y 的符号位，48 字节；
+//                            还原时要在 Fp 上开平方求 y
+//   mcl::IoEcAffineSerialize 未压缩的仿射坐标 [x:y]，96 字节；
+//                            还原时直接取 x, y，不需要开方
+
 // 辅助函数：将 G1 转换为 std::string (二进制数据)
-inline std::string g1_to_bin(const G1& p) {
+inline std::string g1_to_bin(const G1& p, int mode = mcl::IoSerialize) {
     std::string s;
     // mcl::IoSerialize 模式会将数据压缩为紧凑的二进制格式
-    p.getStr(s, mcl::IoSerialize);
+    p.getStr(s, mode);
     return s;
 }
 
 // 辅助函数：将 std::string (二进制数据) 还原为 G1
-inline G1 bin_to_g1(const std::string& s) {
+inline G1 bin_to_g1(const std::string& s, int mode = mcl::IoSerialize) {
     G1 p;
     if (s.empty()) {
         p.clear();  // 视为空串为无穷远点（零元）
     } else {
-        p.setStr(s, mcl::IoSerialize);
+        p.setStr(s, mode);
+    }
+    return p;
+}
+
+// 辅助函数：单个 G1 序列化后的字节数 (两种模式下都是定长，零元也一样)
+inline size_t g1_bin_size(int mode = mcl::IoSerialize) {
+    if (mode & mcl::IoEcAffineSerialize) return 2 * Fp::getByteSize();
+    return G1::getSerializedByteSize();
+}
+
+// 单个点序列化后的最大字节数 (affine 模式下 x、y 各一个 Fp)，
+// 可以直接用作栈上缓冲的大小，不必为每个点分配 std::string
+const size_t kG1MaxBinSize = 2 * (MCL_FP_BIT / 8);
+
+// 辅助函数：还原存储层读出来的点。
+// 存储里的点都是 curator 自己写进去的，不需要再做子群检查 (那是一次标量乘，
+// 比解码本身贵得多)。affine 模式下直接取出 (x, y)，只校验曲线方程；
+// 压缩模式仍然走 mcl 的 deserialize (含开方与子群检查)。
+inline G1 stored_bin_to_g1(const char* data, size_t bytes, int mode) {
+    G1 p;
+    if (!(mode & mcl::IoEcAffineSerialize)) {
+        if (bytes == 0 || p.deserialize(data, bytes, mode) != bytes) {
+            p.clear();  // 空数据视为无穷远点
+        }
+        return p;
+    }
+    const size_t fp_size = Fp::getByteSize();
+    // 全零表示无穷远点
+    bool all_zero = true;
+    for (size_t i = 0; i < bytes && all_zero; ++i) all_zero = (data[i] == 0);
+    if (bytes == 0 || all_zero) {
+        p.clear();
+        return p;
+    }
+    Fp x, y;
+    if (bytes != 2 * fp_size || x.deserialize(data, fp_size) != fp_size ||
+        y.deserialize(data + fp_size, fp_size) != fp_size) {
+        std::cerr << "Error decoding stored point: bad affine encoding"
+                  << std::endl;
+        p.clear();
+        return p;
+    }
+    p.set(x, y, false);
+    if (!mcl::ec::isValidAffine(p)) {
+        std::cerr << "Error decoding stored point: not on curve" << std::endl;
+        p.clear();
     }
     return p;
-}
\ No newline at end of file
+}
+
+// 辅助函数：把 n 个点依次写入 out (调用方保证至少 n * g1_bin_size(mode) 字节)
+// 第 i 个点位于偏移 i * g1_bin_size(mode) 处。
+// Jacobian 坐标的点序列化前必须先归一化，逐点做要 n 次 Fp 求逆；这里先按块
+// 调用 normalizeVec (Montgomery 批量求逆，一块只求一次逆)，再直接写进 out，
+// 不为每个点分配 std::string。
+inline void g1vec_serialize(char* out, const G1* vec, size_t n, int mode) {
+    const size_t point_size = g1_bin_size(mode);
+    const size_t chunk = 64;  // 分块归一化，缓冲区放在栈上
+    G1 normalized[chunk];
+    for (size_t base = 0; base < n; base += chunk) {
+        size_t m = std::min(chunk, n - base);
+        G1::normalizeVec(normalized, vec + base, m);
+        for (size_t i = 0; i < m; ++i) {
+            normalized[i].serialize(out + (base + i) * point_size, point_size,
+                                    mode);
+        }
+    }
+}
+
+// 辅助函数：g1vec_serialize 的逆操作，从 data 读出 n 个存储层的点到 out
+inline void g1vec_deserialize(G1* out, const char* data, size_t n, int mode) {
+    const size_t point_size = g1_bin_size(mode);
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = stored_bin_to_g1(data + i * point_size, point_size, mode);
+    }
+}
+
+// 辅助函数：解码用户提交的 n 个点 (不可信的外部数据，排列同上)。
+// 与 g1vec_deserialize 不同，每个点都走 mcl 的完整校验：在曲线上、
+// 且在 r 阶子群里 (initPairing 之后默认开启，BLS12 上是一次自同态检查)；
+// 压缩模式还要开一次平方根。直接从 data 解码，不为每个点构造 std::string。
+// 返回第一个不合法的点的下标，全部合法时返回 -1
+inline int64_t g1vec_decode(G1* out, const char* data, size_t n, int mode) {
+    const size_t point_size = g1_bin_size(mode);
+    for (size_t i = 0; i < n; ++i) {
+        if (out[i].deserialize(data + i * point_size, point_size, mode) !=
+            point_size) {
+            return (int64_t)i;
+        }
+    }
+    return -1;
+}
+
+// 辅助函数：将整个 G1 向量拼接成一段连续的二进制数据 (一次分配)
+inline std::string g1vec_to_bin(const std::vector<G1>& vec,
+                                int mode = mcl::IoSerialize) {
+    std::string s(vec.size() * g1_bin_size(mode), '\0');
+    g1vec_serialize(&s[0], vec.data(), vec.size(), mode);
+    return s;
+}
+
+// 辅助函数：g1vec_to_bin 的逆操作 (用于存储层读出的数据)
+inline std::vector<G1> bin_to_g1vec(const char* data, size_t bytes,
+                                    int mode = mcl::IoSerialize) {
+    std::vector<G1> vec(bytes / g1_bin_size(mode));
+    g1vec_deserialize(vec.data(), data, vec.size(), mode);
+    return vec;
+}